@@ -24,8 +24,26 @@ SOFTWARE.
 
 #include <unistd.h>
 #include <errno.h>
+#include <stdint.h>
 #include "genprog.h"
 
+#include <fcntl.h>
+#include <poll.h>
+#include <netdb.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#if defined(__x86_64__)
+#define GENPROG_HAS_JIT 1
+#endif
+
 
 #define DEBUG(msg) do { fprintf(stderr,"[%d]DEBUG ",__LINE__); fputs(msg,stderr);fputc('\n',stderr); } while(0)
 #define THROW_ERROR(a) do {fputs(a,stderr);fputc('\n',stderr);assert(0);} while(0)
@@ -34,6 +52,256 @@ SOFTWARE.
 
 static const size_t NPOS=(size_t)-1UL;
 
+/**
+ * Random generators. RANDOM_XOSHIRO is xoshiro256** seeded with SplitMix64,
+ * RANDOM_RAND_R replays the sequences of the former rand_r implementation.
+ * RandomStream derives an independent generator from a parent and an index,
+ * so a task gets the same random numbers whatever the thread running it.
+ */
+static uint64_t RandomMix(uint64_t z)
+	{
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+	}
+
+static uint64_t SplitMix64(uint64_t* x)
+	{
+	*x += 0x9E3779B97F4A7C15ULL;
+	return RandomMix(*x);
+	}
+
+static uint64_t RandomRotl(uint64_t x,int k)
+	{
+	return (x << k) | (x >> (64 - k));
+	}
+
+void RandomInit(RandomPtr r,enum randomKind kind,uint64_t seed)
+	{
+	size_t i;
+	r->kind = kind;
+	if(kind==RANDOM_RAND_R)
+		{
+		r->s[0] = (unsigned int)seed;
+		r->s[1] = r->s[2] = r->s[3] = 0ULL;
+		return;
+		}
+	for(i=0;i< 4;++i) r->s[i] = SplitMix64(&seed);
+	}
+
+/** mixes a rand_r seed with an index, see RandomStream */
+static unsigned int RandomHash32(unsigned int seed,size_t index)
+	{
+	uint32_t h = seed ^ (uint32_t)(index*0x9E3779B9UL);
+	h ^= h >> 16;
+	h *= 0x85EBCA6BU;
+	h ^= h >> 13;
+	h *= 0xC2B2AE35U;
+	h ^= h >> 16;
+	return h;
+	}
+
+/** initializes 'r' with the stream 'index' of 'parent'. 'parent' is not modified */
+void RandomStream(RandomPtr r,const RandomPtr parent,uint64_t index)
+	{
+	if(parent->kind==RANDOM_RAND_R)
+		{
+		RandomInit(r,RANDOM_RAND_R,RandomHash32((unsigned int)parent->s[0],index));
+		return;
+		}
+	RandomInit(r,RANDOM_XOSHIRO,parent->s[0] ^ RandomMix(parent->s[1] + RandomMix(index)));
+	}
+
+uint64_t RandomNext(RandomPtr r)
+	{
+	uint64_t* s = r->s;
+	uint64_t result,t;
+	if(r->kind==RANDOM_RAND_R)
+		{
+		unsigned int seed = (unsigned int)s[0];
+		result = (uint64_t)rand_r(&seed);
+		s[0] = seed;
+		return result;
+		}
+	result = RandomRotl(s[1]*5,7)*9;
+	t = s[1] << 17;
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = RandomRotl(s[3],45);
+	return result;
+	}
+
+/** in [0,RAND_MAX] */
+unsigned int RandomUInt(RandomPtr r)
+	{
+	if(r->kind==RANDOM_RAND_R) return (unsigned int)RandomNext(r);
+	return (unsigned int)(RandomNext(r) >> 33);
+	}
+
+/** in [0,1) */
+double RandomFloat(RandomPtr r)
+	{
+	if(r->kind==RANDOM_RAND_R) return (double)RandomNext(r)/(double)RAND_MAX;
+	return (double)(RandomNext(r) >> 11) * 0x1.0p-53;
+	}
+
+/** in [0,n), without the bias of a modulo (Lemire's method) */
+size_t RandomBelow(RandomPtr r,size_t n)
+	{
+	uint64_t x;
+	unsigned __int128 m;
+	if(r->kind==RANDOM_RAND_R) return (size_t)(RandomNext(r) % n);
+	x = RandomNext(r);
+	m = (unsigned __int128)x * n;
+	if((uint64_t)m < n)
+		{
+		uint64_t t = (uint64_t)(-n) % n;
+		while((uint64_t)m < t)
+			{
+			x = RandomNext(r);
+			m = (unsigned __int128)x * n;
+			}
+		}
+	return (size_t)(m >> 64);
+	}
+
+/** when not NULL, the random state used by the current thread instead of config->random */
+static __thread RandomPtr thread_random=NULL;
+
+RandomPtr RandomState(ConfigPtr cfg)
+	{
+	return thread_random!=NULL?thread_random:&(cfg->random);
+	}
+
+/** number of rows evaluated at once by ProgramEvalBlock */
+#define EVAL_BLOCK_SIZE 256
+
+/**
+ * Arena: a bump allocator for the genomes created during a generation. The
+ * memory is only released all at once by ArenaClear, the chunks being
+ * kept for the next use. Not thread safe: each worker has its own nursery.
+ */
+#define ARENA_CHUNK_SIZE (1024UL*1024UL)
+#define ARENA_ALIGN 16UL
+
+typedef struct arena_chunk_t
+	{
+	struct arena_chunk_t* next;
+	size_t size;
+	size_t used;
+	unsigned char* data;
+	} ArenaChunk,*ArenaChunkPtr;
+
+typedef struct arena_t
+	{
+	ArenaChunkPtr first;
+	ArenaChunkPtr last;
+	/* chunk currently used for allocation, the following chunks are empty */
+	ArenaChunkPtr current;
+	} Arena,*ArenaPtr;
+
+/** state of an arena, to release what was allocated after it */
+typedef struct arena_mark_t
+	{
+	ArenaChunkPtr chunk;
+	size_t used;
+	} ArenaMark;
+
+/** index of the thread pool worker running the current thread, 0 for the main thread */
+static __thread size_t thread_worker=0UL;
+/** when not NULL, the arena where the current thread creates the new genomes */
+static __thread ArenaPtr thread_arena=NULL;
+
+static ArenaPtr ArenaNew()
+	{
+	ArenaPtr a=(ArenaPtr)calloc(1,sizeof(Arena));
+	if(a==NULL) THROW_ERROR("boum");
+	return a;
+	}
+
+/** returns 'n' bytes, set to 0 */
+static void* ArenaAlloc(ArenaPtr a,size_t n)
+	{
+	void* ptr;
+	n = (n+ARENA_ALIGN-1UL) & ~(ARENA_ALIGN-1UL);
+	while(a->current!=NULL && a->current->used + n > a->current->size)
+		{
+		a->current = a->current->next;
+		}
+	if(a->current==NULL)
+		{
+		ArenaChunkPtr c=(ArenaChunkPtr)calloc(1,sizeof(ArenaChunk));
+		if(c==NULL) THROW_ERROR("boum");
+		c->size = MAX(n,ARENA_CHUNK_SIZE);
+		c->data = (unsigned char*)malloc(c->size);
+		if(c->data==NULL) THROW_ERROR("boum");
+		if(a->last==NULL)
+			{
+			a->first = c;
+			}
+		else
+			{
+			a->last->next = c;
+			}
+		a->last = c;
+		a->current = c;
+		}
+	ptr = (void*)&(a->current->data[a->current->used]);
+	a->current->used += n;
+	memset(ptr,0,n);
+	return ptr;
+	}
+
+/** releases everything allocated in the arena */
+static void ArenaClear(ArenaPtr a)
+	{
+	ArenaChunkPtr c;
+	if(a==NULL) return;
+	for(c=a->first;c!=NULL;c=c->next) c->used=0UL;
+	a->current = a->first;
+	}
+
+static ArenaMark ArenaGetMark(const ArenaPtr a)
+	{
+	ArenaMark mark;
+	mark.chunk = (a==NULL ? NULL : a->current);
+	mark.used = (mark.chunk==NULL ? 0UL : mark.chunk->used);
+	return mark;
+	}
+
+/** releases everything allocated since ArenaGetMark returned 'mark' */
+static void ArenaRelease(ArenaPtr a,const ArenaMark* mark)
+	{
+	ArenaChunkPtr c;
+	if(a==NULL) return;
+	if(mark->chunk==NULL)
+		{
+		ArenaClear(a);
+		return;
+		}
+	for(c=mark->chunk->next;c!=NULL;c=c->next) c->used=0UL;
+	mark->chunk->used = mark->used;
+	a->current = mark->chunk;
+	}
+
+static void ArenaFree(ArenaPtr a)
+	{
+	ArenaChunkPtr c;
+	if(a==NULL) return;
+	c=a->first;
+	while(c!=NULL)
+		{
+		ArenaChunkPtr next=c->next;
+		free(c->data);
+		free(c);
+		c=next;
+		}
+	free(a);
+	}
+
 
 floating_t SpreadSheetAt(const SpreadSheetPtr ptr,size_t y,size_t x)
 	{
@@ -47,42 +315,99 @@ floating_t SpreadSheetAt(const SpreadSheetPtr ptr,size_t y,size_t x)
 		fprintf(stderr,"X=%d >= cols=(%d)\n",x, SpreadSheetColumns(ptr) );
 		THROW_ERROR("x>=col");
 		}
-	return ptr->data[ y*SpreadSheetColumns(ptr) + x];
+	return ptr->columnar[ x*SpreadSheetRows(ptr) + y];
+	}
+
+/** returns the column-major array of the values in column 'x' */
+const floating_t* SpreadSheetColumn(const SpreadSheetPtr ptr,size_t x)
+	{
+	if( x >= SpreadSheetColumns(ptr) )
+		{
+		fprintf(stderr,"X=%d >= cols=(%d)\n",(int)x,(int)SpreadSheetColumns(ptr) );
+		THROW_ERROR("x>=col");
+		}
+	return &(ptr->columnar[ x*SpreadSheetRows(ptr) ]);
+	}
+
+
+
+
+/* tag of the operators and the columns in a Node: a quiet NaN */
+#define NODE_TAG 0x7FFC000000000000ULL
+#define NODE_TAG_MASK 0xFFFF000000000000ULL
+#define NODE_INDEX_MASK 0xFFFFFFULL
+
+enum nodeType NodeType(const NodePtr node)
+	{
+	if((node->bits & NODE_TAG_MASK)!=NODE_TAG) return CONSTANT;
+	return (enum nodeType)((node->bits>>32) & 0xFF);
+	}
+
+floating_t NodeConstant(const NodePtr node)
+	{
+	return node->constant;
+	}
+
+size_t NodeColumn(const NodePtr node)
+	{
+	return (size_t)(node->bits & NODE_INDEX_MASK);
+	}
+
+size_t NodeOperator(const NodePtr node)
+	{
+	return (size_t)(node->bits & NODE_INDEX_MASK);
 	}
 
+void NodeSetConstant(NodePtr node,floating_t v)
+	{
+	if(isnan(v)) THROW_ERROR("NaN constant");
+	node->constant = v;
+	}
+
+static void NodeSetTagged(NodePtr node,enum nodeType type,size_t index)
+	{
+	if(index > NODE_INDEX_MASK) THROW_ERROR("index too large");
+	node->bits = NODE_TAG | ((uint64_t)type<<32) | (uint64_t)index;
+	}
 
+void NodeSetColumn(NodePtr node,size_t column)
+	{
+	NodeSetTagged(node,COLUMN,column);
+	}
 
+void NodeSetOperator(NodePtr node,size_t operator)
+	{
+	NodeSetTagged(node,OPERATOR,operator);
+	}
 
 static void NodeInitConstant(ConfigPtr cfg,NodePtr op)
 	{
-	op->type = CONSTANT;
+	floating_t v;
 	if(RANDOM_FLOAT(cfg)<0.5)
 		{
-		op->core.constant = RANDOM_FLOAT(cfg);
+		v = RANDOM_FLOAT(cfg);
 		}
 	else
 		{
-		op->core.constant = (double)rand_r(&(cfg->seedp));
+		v = (double)RandomUInt(RandomState(cfg));
 		}
-	if(RANDOM_FLOAT(cfg)<0.5) op->core.constant *=-1;
+	if(RANDOM_FLOAT(cfg)<0.5) v *=-1;
+	NodeSetConstant(op,v);
 	}
 	
 static void NodeInitColumn(ConfigPtr cfg,NodePtr op)
 	{
-	op->type = OPERATOR;
-	op->core.operator= RANDOM_SIZE_T(cfg, OperatorListSize(cfg->operators) );
+	NodeSetOperator(op, RANDOM_SIZE_T(cfg, OperatorListSize(cfg->operators) ));
 	}
 	
 static void NodeInitOperator(ConfigPtr cfg,NodePtr op)
 	{
-	op->type = COLUMN;
-	op->core.column = RANDOM_SIZE_T(cfg, SpreadSheetColumns(cfg->spreadsheet)-1);
-
+	NodeSetColumn(op, RANDOM_SIZE_T(cfg, SpreadSheetColumns(cfg->spreadsheet)-1));
 	}
 
 static void NodeMut(ConfigPtr cfg,NodePtr op)
 	{
-	switch(op->type)
+	switch(NodeType(op))
 		{
 		case CONSTANT: NodeInitConstant(cfg,op);break;
 		case OPERATOR : NodeInitOperator(cfg,op);break;
@@ -112,10 +437,67 @@ static void NodeInit(ConfigPtr cfg,NodePtr op)
 
 	}
 
+/** number of children of the node */
+static size_t NodeArity(ConfigPtr cfg,const NodePtr op)
+	{
+	if(NodeType(op)!=OPERATOR) return 0UL;
+	return OperatorListAt(cfg->operators,NodeOperator(op))->num_children;
+	}
+
+/**
+ * writes a random and complete tree in 'nodes', in prefix order, and returns
+ * its number of nodes. The tree has at most 'max_size' nodes and, unless
+ * max_size is too small, at least 'min_size' nodes.
+ */
+static size_t NodesGrow(ConfigPtr cfg,NodePtr nodes,size_t min_size,size_t max_size)
+	{
+	size_t n=0UL;
+	/* number of children still to be written */
+	size_t open=1UL;
+	if(max_size==0UL) THROW_ERROR("BOUM");
+	while(open>0UL)
+		{
+		NodePtr node=&nodes[n];
+		/* number of nodes that can follow this one */
+		size_t left = max_size-(n+1);
+		NodeInit(cfg,node);
+		if(NodeType(node)!=OPERATOR && open==1UL && n+1 < min_size)
+			{
+			/* the tree would be complete: too small. (NodeInitColumn creates an operator) */
+			NodeInitColumn(cfg,node);
+			}
+		if(open-1UL+NodeArity(cfg,node) > left)
+			{
+			/* not enough room for the children: a constant or a column */
+			if(RANDOM_FLOAT(cfg)<0.5)
+				{
+				NodeInitConstant(cfg,node);
+				}
+			else
+				{
+				NodeInitOperator(cfg,node);
+				}
+			}
+		open = open-1UL+NodeArity(cfg,node);
+		n++;
+		}
+	return n;
+	}
+
+/** creates an empty genome, in thread_arena if any */
 GenomePtr GenomeNew1(ConfigPtr cfg)
 	{
-	GenomePtr g=(GenomePtr)calloc(1,sizeof(Genome));
-	if(g==NULL) THROW_ERROR("boum");
+	GenomePtr g;
+	if(thread_arena!=NULL)
+		{
+		g=(GenomePtr)ArenaAlloc(thread_arena,sizeof(Genome));
+		g->arena = thread_arena;
+		}
+	else
+		{
+		g=(GenomePtr)calloc(1,sizeof(Genome));
+		if(g==NULL) THROW_ERROR("boum");
+		}
 
 	g->config = cfg;
 	g->node_count = 0;
@@ -124,6 +506,7 @@ GenomePtr GenomeNew1(ConfigPtr cfg)
 	g->fitness = NAN;
 	g->generation = -1L;
 	g->creation = time(NULL);
+	g->program = NULL;
 	return g;
 	}
 
@@ -140,8 +523,51 @@ GenomePtr GenomeClone(const GenomePtr src)
 	g->fitness = src->fitness;
 	g->generation = src ->generation;
 	g->creation = src->creation; 
+	g->program = NULL;
 	return g;
 	}	
+
+/** allocates 'n' nodes for the genome, in its arena if any */
+static NodePtr GenomeNodesAlloc(GenomePtr g,size_t n)
+	{
+	NodePtr nodes;
+	if(g->arena!=NULL) return (NodePtr)ArenaAlloc(g->arena,n*sizeof(Node));
+	nodes=(NodePtr)calloc(n,sizeof(Node));
+	if(nodes==NULL) THROW_ERROR("boum");
+	return nodes;
+	}
+
+/** changes the number of allocated nodes, keeping the first ones, like realloc */
+static void GenomeNodesResize(GenomePtr g,size_t n)
+	{
+	if(g->arena!=NULL)
+		{
+		NodePtr nodes=(NodePtr)ArenaAlloc(g->arena,n*sizeof(Node));
+		memcpy((void*)nodes,(void*)g->nodes,MIN(n,g->node_count)*sizeof(Node));
+		g->nodes = nodes;
+		}
+	else
+		{
+		g->nodes = (NodePtr)realloc(g->nodes,n*sizeof(Node));
+		if(g->nodes==NULL) THROW_ERROR("boum");
+		}
+	}
+
+/** moves the genome and its nodes to the arena. 'g' must not be used anymore */
+static GenomePtr GenomeMoveTo(GenomePtr g,ArenaPtr arena)
+	{
+	GenomePtr copy=(GenomePtr)ArenaAlloc(arena,sizeof(Genome));
+	*copy = *g;
+	copy->arena = arena;
+	copy->nodes = GenomeNodesAlloc(copy,g->node_count);
+	memcpy((void*)copy->nodes,(void*)g->nodes,sizeof(Node)*(g->node_count));
+	if(g->arena==NULL)
+		{
+		free(g->nodes);
+		free(g);
+		}
+	return copy;
+	}
 	
 
 
@@ -165,8 +591,12 @@ GenomePtr GenomeNew(ConfigPtr cfg)
 	g->node_count = cfg->min_base_per_genome +
 		RANDOM_SIZE_T(cfg, abs(cfg->max_base_per_genome - cfg->min_base_per_genome)) ;
 		
-	g->nodes = (NodePtr)calloc(g->node_count,sizeof(Node));
-	if(g->nodes==NULL) THROW_ERROR("boum");
+	g->nodes = GenomeNodesAlloc(g,g->node_count);
+	if(cfg->subtree_operators)
+		{
+		g->node_count = NodesGrow(cfg,g->nodes,cfg->min_base_per_genome,g->node_count);
+		return g;
+		}
 	for(i=0;i <  GenomeSize(g) ; ++i)
 		{
 		NodeInit(cfg,&g->nodes[i]);
@@ -175,9 +605,42 @@ GenomePtr GenomeNew(ConfigPtr cfg)
 	return g;
 	}
 
+/**
+ * true if all the nodes of a genome read from outside (a message, a file) can
+ * be used with 'cfg': no NaN constant, no unknown type, no operator or column
+ * out of range, and the tagged nodes are written as NodeSetTagged writes them.
+ */
+static boolean_t GenomeNodesValid(ConfigPtr cfg,const GenomePtr g)
+	{
+	size_t i;
+	for(i=0;i< g->node_count;++i)
+		{
+		NodePtr node=&(g->nodes[i]);
+		switch(NodeType(node))
+			{
+			case CONSTANT:
+				if(isnan(NodeConstant(node))) return 0;
+				break;
+			case OPERATOR:
+				if(NodeOperator(node) >= OperatorListSize(cfg->operators)) return 0;
+				break;
+			case COLUMN:
+				if(NodeColumn(node)+1 >= SpreadSheetColumns(cfg->spreadsheet)) return 0;
+				break;
+			default: return 0;
+			}
+		if(NodeType(node)!=CONSTANT &&
+			node->bits!=(NODE_TAG | ((uint64_t)NodeType(node)<<32) | (node->bits & NODE_INDEX_MASK))) return 0;
+		}
+	return 1;
+	}
+
 void GenomeFree(GenomePtr ptr)
 	{
 	if(ptr==NULL) return;
+	GenomeUncompile(ptr);
+	/* released with its arena */
+	if(ptr->arena!=NULL) return;
 	free( ptr-> nodes );
 	free(ptr);
 	}
@@ -208,12 +671,6 @@ int GenomeCompare(const GenomePtr g1,const GenomePtr g2)
 		}
 	return 0;
 	}
-static int _GenomeCompare(const void* a,const void* b)
-	{
-	const GenomePtr g1=(const GenomePtr)(*((const Genome**)a));
-	const GenomePtr g2=(const GenomePtr)(*((const Genome**)b));
-	return GenomeCompare(g1,g2);
-	}
 
 
 
@@ -248,6 +705,7 @@ static GenerationPtr GenerationNew(ConfigPtr cfg)
 		;
 	g->genomes=(Genome**)calloc(g->genome_count,sizeof(Genome*));
 	if(g->genomes==NULL) THROW_ERROR("boum");
+	g->capacity = g->genome_count;
 	
 	for(i=0;i< GenerationCount(g) ;++i)
 		{
@@ -259,11 +717,15 @@ static GenerationPtr GenerationNew(ConfigPtr cfg)
 
 void GenerationAdd(GenerationPtr g,GenomePtr genome)
 	{
-	g->genomes=(Genome**)realloc(
-		g->genomes,
-		(g->genome_count+1)*sizeof(GenomePtr)
-		);
-	if(g->genomes==NULL) THROW_ERROR("boum");
+	if(g->genome_count == g->capacity)
+		{
+		g->capacity = (g->capacity==0UL ? 64UL : g->capacity*2);
+		g->genomes=(Genome**)realloc(
+			g->genomes,
+			g->capacity*sizeof(GenomePtr)
+			);
+		if(g->genomes==NULL) THROW_ERROR("boum");
+		}
 	g->genomes[g->genome_count] = genome;
 	g->genome_count++;
 	}
@@ -293,6 +755,53 @@ static floating_t _sqrt(floating_t* array) { return array[0]<=0?NAN:sqrt(array[0
 static floating_t _negate(floating_t* array) { return  - array[0];}
 static floating_t _invert(floating_t* array) { return array[0]==0?NAN:1.0/array[0];}
 
+/* array versions of the operators. Written as plain loops over contiguous
+ * arrays so the compiler can vectorize them; the division is always computed
+ * and then masked so the loop stays branch-free */
+static void _plus_array(floating_t* dest,const floating_t* a,const floating_t* b,size_t n)
+	{
+	size_t i;
+	for(i=0;i< n;++i) dest[i] = a[i] + b[i];
+	}
+static void _minus_array(floating_t* dest,const floating_t* a,const floating_t* b,size_t n)
+	{
+	size_t i;
+	for(i=0;i< n;++i) dest[i] = a[i] - b[i];
+	}
+static void _mul_array(floating_t* dest,const floating_t* a,const floating_t* b,size_t n)
+	{
+	size_t i;
+	for(i=0;i< n;++i) dest[i] = a[i] * b[i];
+	}
+static void _div_array(floating_t* dest,const floating_t* a,const floating_t* b,size_t n)
+	{
+	size_t i;
+	for(i=0;i< n;++i)
+		{
+		floating_t q = a[i] / b[i];
+		dest[i] = (b[i]==0?NAN:q);
+		}
+	}
+static void _sqrt_array(floating_t* dest,const floating_t* a,const floating_t* b,size_t n)
+	{
+	size_t i;
+	for(i=0;i< n;++i) dest[i] = (a[i]<=0?NAN:sqrt(a[i]));
+	}
+static void _negate_array(floating_t* dest,const floating_t* a,const floating_t* b,size_t n)
+	{
+	size_t i;
+	for(i=0;i< n;++i) dest[i] = -a[i];
+	}
+static void _invert_array(floating_t* dest,const floating_t* a,const floating_t* b,size_t n)
+	{
+	size_t i;
+	for(i=0;i< n;++i)
+		{
+		floating_t q = 1.0 / a[i];
+		dest[i] = (a[i]==0?NAN:q);
+		}
+	}
+
 #define NEW_OPERATOR (OperatorPtr)(OperatorPtr)calloc(1,sizeof(Operator));\
 	if(op==NULL) THROW_ERROR("BOUM");\
 	ALL_OPERATORS->operators = (Operator**)realloc(ALL_OPERATORS->operators,sizeof(OperatorPtr)*(ALL_OPERATORS->size+1));\
@@ -314,6 +823,8 @@ OperatorListPtr OperatorsListNew()
 	strcpy(op->name,"Add");
 	op->num_children = 2UL;
 	op->eval = _plus;
+	op->eval_array = _plus_array;
+	op->opcode = OP_ADD;
 	ALL_OPERATORS->plus=op;
 
 	
@@ -322,6 +833,8 @@ OperatorListPtr OperatorsListNew()
 	strcpy(op->name,"Minus");
 	op->num_children = 2UL;
 	op->eval = _minus;
+	op->eval_array = _minus_array;
+	op->opcode = OP_MINUS;
 	ALL_OPERATORS->minus=op;
 
 	
@@ -330,6 +843,8 @@ OperatorListPtr OperatorsListNew()
 	strcpy(op->name,"Mul");
 	op->num_children = 2UL;
 	op->eval = _mul;
+	op->eval_array = _mul_array;
+	op->opcode = OP_MUL;
 	ALL_OPERATORS->mul=op;
 
 	
@@ -338,6 +853,8 @@ OperatorListPtr OperatorsListNew()
 	strcpy(op->name,"Div");
 	op->num_children = 2UL;
 	op->eval = _div;
+	op->eval_array = _div_array;
+	op->opcode = OP_DIV;
 	ALL_OPERATORS->div=op;
 	
 	
@@ -346,12 +863,16 @@ OperatorListPtr OperatorsListNew()
 	strcpy(op->name,"Negate");
 	op->num_children = 1UL;
 	op->eval = _negate;
+	op->eval_array = _negate_array;
+	op->opcode = OP_NEGATE;
 
 	/** Invert **/
 	op = NEW_OPERATOR;
 	strcpy(op->name,"Invert");
 	op->num_children = 1UL;
 	op->eval = _invert;
+	op->eval_array = _invert_array;
+	op->opcode = OP_INVERT;
 
 	
 	/** SQRT **/
@@ -360,6 +881,8 @@ OperatorListPtr OperatorsListNew()
 	strcpy(op->name,"Sqrt");
 	op->num_children = 1UL;
 	op->eval = _sqrt;
+	op->eval_array = _sqrt_array;
+	op->opcode = OP_SQRT;
 	*/
 
 	return ALL_OPERATORS;
@@ -398,11 +921,11 @@ static void GenomeEval1(
 		}
 	
 	node = GenomeAt(genome, *nodeIndex );
-	switch(node->type)
+	switch(NodeType(node))
 		{
 		case CONSTANT:
 			{
-			*value = node->core.constant;
+			*value = NodeConstant(node);
 			break;
 			}
 		case COLUMN:
@@ -410,16 +933,16 @@ static void GenomeEval1(
 			*value = SpreadSheetAt(
 				genome->config->spreadsheet,
 				rowIndex,
-				node->core.column
+				NodeColumn(node)
 				);
-			/* fprintf(stderr,"Value[%d][%d] = %f \n", rowIndex,node->core.column,*value ); */
+			/* fprintf(stderr,"Value[%d][%d] = %f \n", rowIndex,NodeColumn(node),*value ); */
 			break;
 			}
 		case OPERATOR:
 			{
 			size_t i;
 			floating_t values[MAX_ARITY];
-			OperatorPtr op = OperatorListAt(genome->config->operators,node->core.operator);
+			OperatorPtr op = OperatorListAt(genome->config->operators,NodeOperator(node));
 			
 			//fprintf(stderr,"Operator = %s \n",op->name);
 			
@@ -472,22 +995,22 @@ void _GenomePrint(const GenomePtr g,size_t *nodeIndex,FILE* out)
 		}
 	
 	node = GenomeAt(g, *nodeIndex );
-	switch(node->type)
+	switch(NodeType(node))
 		{
 		case CONSTANT:
 			{
-			fprintf(out,"%f", node->core.constant);
+			fprintf(out,"%f", NodeConstant(node));
 			break;
 			}
 		case COLUMN:
 			{
-			fprintf(out,"${%d}", node->core.column + 1);
+			fprintf(out,"${%d}", NodeColumn(node) + 1);
 			break;
 			}
 		case OPERATOR:
 			{
 			size_t i;
-			OperatorPtr op = OperatorListAt(g->config->operators, node->core.operator);
+			OperatorPtr op = OperatorListAt(g->config->operators, NodeOperator(node));
 			fprintf(out,"%s(", op->name);
 			
 			for(i=0;i< op->num_children;++i)
@@ -525,458 +1048,4432 @@ boolean_t GenomeEquals(const GenomePtr g1,const GenomePtr g2)
 	}
 
 
-static void GenomeEval(GenomePtr g)
+/** returns a scratch buffer of at least 'n' floating_t, reused between calls */
+static floating_t* EvalWorkspace(size_t n)
 	{
-	
-	floating_t min_value= DBL_MAX;
-	floating_t max_value=-DBL_MAX;
-	size_t rowIndex;
-	size_t num_errors=0UL;
-	size_t max_errors=(size_t)(g->config->max_fraction_of_errors)*SpreadSheetRows(g->config->spreadsheet);
-	floating_t  *norms=(floating_t*)calloc(SpreadSheetRows(g->config->spreadsheet),sizeof(floating_t));
-	if(norms==NULL) THROW_ERROR("BOUM");
-	
-	if( SpreadSheetRows(g->config->spreadsheet)==0) THROW_ERROR("BOUM");
-	
-	for(rowIndex=0;
-		rowIndex< SpreadSheetRows(g->config->spreadsheet);
-		++rowIndex)
-		{
-		size_t nodeIndex=0;
-		floating_t  value=0.0;
-		boolean_t  error=0;
-		
-		
-		GenomeEval1(g,rowIndex,&nodeIndex,&value,&error);
-		if(error)
-			{
-			num_errors++;
-			norms[rowIndex]=NAN;
-			if( num_errors>max_errors )
-				{
-				//fprintf(stderr,"too many errors\n");
-				break;
-				}
-			continue;
-			}
-		if( g->config->remove_introns )
-			{
-			g->node_count=1+nodeIndex;
-			}
-		norms[rowIndex]=value;
-		if(value < min_value) min_value = value;
-		if(value > max_value) max_value = value;
-		}
-	
-	
-	if(max_value==min_value || num_errors>max_errors)
+	static __thread floating_t* workspace=NULL;
+	static __thread size_t workspace_size=0UL;
+	if( n > workspace_size )
 		{
-		g->bad_flag=1;
-		g->fitness=NAN;
+		workspace = (floating_t*)realloc(workspace,n*sizeof(floating_t));
+		if(workspace==NULL) THROW_ERROR("BOUM");
+		workspace_size = n;
 		}
-	else
+	return workspace;
+	}
+
+static size_t OpCodeArity(enum opCode opcode)
+	{
+	switch(opcode)
 		{
-		g->fitness=0.0;
-		for(rowIndex=0;
-			rowIndex< SpreadSheetRows(g->config->spreadsheet);
-			++rowIndex)
-			{
-			double diff=0.0;
-			if( isnan(norms[rowIndex]) ) continue;
-			if(g->config->normalize_data)
-				{
-				norms[rowIndex]=(norms[rowIndex]-min_value)/(max_value-min_value);
-				diff = fabs( norms[rowIndex] - g->config->spreadsheet->normalized[rowIndex] );
-				}
-			else
-				{
-				diff = fabs( norms[rowIndex] - SpreadSheetAt(g->config->spreadsheet,rowIndex,SpreadSheetColumns(g->config->spreadsheet)-1) );
-				}
-			g->fitness += pow(diff,2);
-			}
-		//fprintf(stderr,"fitness =%f\n",g->fitness);
+		case OP_CONSTANT: case OP_COLUMN: return 0UL;
+		case OP_NEGATE: case OP_INVERT: case OP_SQRT: return 1UL;
+		default: return 2UL;
 		}
-	free(norms);
-	
 	}
 
-
-size_t SpreadSheetColumns(const SpreadSheetPtr ptr)
+/** true if the instructions from 'start' to the end of the program are the constant 'v' */
+static boolean_t ProgramIsConstant(const ProgramPtr prog,size_t start,floating_t v)
 	{
-	return ptr->columns;
+	return prog->size == start+1 &&
+		prog->instructions[start].opcode == OP_CONSTANT &&
+		prog->instructions[start].arg.constant == v;
 	}
 
-size_t SpreadSheetRows(const SpreadSheetPtr ptr)
+/**
+ * called by ProgramEmit once the children of 'op' have been emitted, 'start'
+ * holding the index of the first instruction of each child. Replaces the
+ * operation by a shorter equivalent program:
+ *   - a constant, when all the children are constant (unless the result is NAN)
+ *   - x for Add(x,0) Add(0,x) Minus(x,0) Mul(x,1) Mul(1,x) Div(x,1)
+ *   - x for Negate(Negate(x))
+ * Invert(Invert(x)) is kept: 1/(1/x) is not always x and Invert(0) is an error.
+ * The sign of zero may change (-0+0 is +0) but it cannot be observed, as a
+ * division by zero is always an error.
+ * returns 1 if the operation doesn't need to be emitted.
+ */
+static boolean_t ProgramSimplify(ProgramPtr prog,const OperatorPtr op,const size_t* start)
 	{
-	return ptr->size/SpreadSheetColumns(ptr);
+	InstructionPtr insts = prog->instructions;
+	size_t i;
+	boolean_t all_constants=1;
+	for(i=0;i< op->num_children;++i)
+		{
+		size_t end = (i+1< op->num_children ? start[i+1] : prog->size);
+		if(end!=start[i]+1 || insts[start[i]].opcode!=OP_CONSTANT) all_constants=0;
+		}
+	if(all_constants)
+		{
+		floating_t args[2];
+		floating_t v;
+		for(i=0;i< op->num_children;++i) args[i] = insts[start[i]].arg.constant;
+		v = op->eval(args);
+		if(isnan(v)) return 0;
+		prog->size = start[0];
+		insts[prog->size].opcode = OP_CONSTANT;
+		insts[prog->size].arg.constant = v;
+		prog->size++;
+		return 1;
+		}
+	switch(op->opcode)
+		{
+		case OP_NEGATE:
+			{
+			if(prog->size > start[0] && insts[prog->size-1].opcode==OP_NEGATE)
+				{
+				prog->size--;
+				return 1;
+				}
+			return 0;
+			}
+		case OP_ADD: case OP_MINUS: case OP_MUL: case OP_DIV:
+			{
+			floating_t identity = (op->opcode==OP_ADD || op->opcode==OP_MINUS ? 0.0 : 1.0);
+			/* op(x,identity) */
+			if(ProgramIsConstant(prog,start[1],identity))
+				{
+				prog->size = start[1];
+				return 1;
+				}
+			/* op(identity,x) for the commutative operators */
+			if( (op->opcode==OP_ADD || op->opcode==OP_MUL) &&
+				start[1]==start[0]+1 &&
+				insts[start[0]].opcode==OP_CONSTANT &&
+				insts[start[0]].arg.constant==identity)
+				{
+				memmove(&insts[start[0]],&insts[start[1]],(prog->size-start[1])*sizeof(Instruction));
+				prog->size--;
+				return 1;
+				}
+			return 0;
+			}
+		default: return 0;
+		}
 	}
 
+/** appends the subtree starting at *nodeIndex to the program, in postfix order. returns 0 if the tree is truncated */
+static boolean_t ProgramEmit(ProgramPtr prog,const GenomePtr g,size_t *nodeIndex)
+	{
+	NodePtr node=NULL;
+	InstructionPtr inst=NULL;
+	if( *nodeIndex >= GenomeSize(g)) return 0;
+	
+	node = GenomeAt(g, *nodeIndex );
+	switch(NodeType(node))
+		{
+		case CONSTANT:
+			{
+			inst = &(prog->instructions[prog->size++]);
+			inst->opcode = OP_CONSTANT;
+			inst->arg.constant = NodeConstant(node);
+			break;
+			}
+		case COLUMN:
+			{
+			if( NodeColumn(node)+1 >= SpreadSheetColumns(g->config->spreadsheet)) THROW_ERROR("BOUM");
+			inst = &(prog->instructions[prog->size++]);
+			inst->opcode = OP_COLUMN;
+			inst->arg.column = NodeColumn(node);
+			break;
+			}
+		case OPERATOR:
+			{
+			size_t i;
+			/* start of the instructions of each child */
+			size_t start[2];
+			OperatorPtr op = OperatorListAt(g->config->operators,NodeOperator(node));
+			if(op->num_children > 2UL) THROW_ERROR("BOUM");
+			for(i=0;i< op->num_children;++i)
+				{
+				*nodeIndex=*nodeIndex + 1;
+				start[i] = prog->size;
+				if(!ProgramEmit(prog,g,nodeIndex)) return 0;
+				}
+			if(g->config->simplify && ProgramSimplify(prog,op,start)) break;
+			inst = &(prog->instructions[prog->size++]);
+			inst->opcode = op->opcode;
+			break;
+			}
+		default: THROW_ERROR("BOUM");break;
+		}
+	return 1;
+	}
 
+#ifdef GENPROG_HAS_JIT
 /**
- * read a SpreadSheet from a FILE
+ * x86-64 JIT. A program is translated to SSE2 code processing two rows per
+ * iteration (packed doubles) plus one scalar row for the tail. The stack of
+ * the program is held in xmm0-xmm13, xmm14 is zero and xmm15 a temporary.
+ * The generated function follows the System V ABI:
+ *    rdi: one pointer per column, rsi: constants, rdx: output, rcx: number of rows.
  */
-SpreadSheetPtr SpreadSheetRead(FILE* in)
+typedef void (*JitFunction)(const floating_t** columns,const floating_t* constants,floating_t* out,size_t n);
+
+#define JIT_MAX_STACK 14
+#define JIT_ZERO 14
+#define JIT_TMP 15
+/* SSE2 prefixes for packed / scalar doubles */
+#define JIT_PD 0x66
+#define JIT_SD 0xF2
+/* the two first pairs of constants are 1.0 and -0.0 (sign mask) */
+#define JIT_CONSTANT_ONE 0
+#define JIT_CONSTANT_SIGN 1
+#define JIT_FIRST_CONSTANT 2
+
+typedef struct jit_buffer_t
 	{
-	size_t i=0UL;
-	floating_t min_value,max_value;
-	size_t curr_cols=0,curr_lines=0UL;
-	SpreadSheetPtr p=(SpreadSheetPtr)calloc(1,sizeof(SpreadSheet));
-	if(p==NULL) THROW_ERROR("Out of memory");
-	
-	while(!feof(in))
+	unsigned char* code;
+	size_t size;
+	size_t capacity;
+	} JitBuffer,*JitBufferPtr;
+
+static void JitByte(JitBufferPtr b,unsigned int c)
+	{
+	if(b->size >= b->capacity) THROW_ERROR("JIT buffer overflow");
+	b->code[b->size++] = (unsigned char)c;
+	}
+
+static void JitInt32(JitBufferPtr b,int32_t v)
+	{
+	uint32_t u=(uint32_t)v;
+	JitByte(b,u&0xFF);
+	JitByte(b,(u>>8)&0xFF);
+	JitByte(b,(u>>16)&0xFF);
+	JitByte(b,(u>>24)&0xFF);
+	}
+
+/** patches the rel32 of the jump ending at 'offset' so it goes to the current position */
+static void JitPatch(JitBufferPtr b,size_t offset)
+	{
+	size_t save=b->size;
+	b->size = offset-4;
+	JitInt32(b,(int32_t)(save-offset));
+	b->size = save;
+	}
+
+/** xmm 'dest' = xmm 'dest' (opcode) xmm 'src' */
+static void JitSSE(JitBufferPtr b,unsigned int prefix,unsigned int opcode,unsigned int dest,unsigned int src)
+	{
+	unsigned int rex = 0x40 | (dest>=8?0x04:0) | (src>=8?0x01:0);
+	JitByte(b,prefix);
+	if(rex!=0x40) JitByte(b,rex);
+	JitByte(b,0x0F);
+	JitByte(b,opcode);
+	JitByte(b,0xC0 | ((dest&7)<<3) | (src&7));
+	}
+
+/** xmm 'dest' = mask(xmm 'dest' (predicate) xmm 'src') */
+static void JitCompare(JitBufferPtr b,unsigned int prefix,unsigned int dest,unsigned int src,unsigned int predicate)
+	{
+	JitSSE(b,prefix,0xC2,dest,src);
+	JitByte(b,predicate);
+	}
+
+/** movupd/movsd xmm 'dest' , [rsi + 16*index] */
+static void JitLoadConstant(JitBufferPtr b,unsigned int prefix,unsigned int dest,size_t index)
+	{
+	JitByte(b,prefix);
+	if(dest>=8) JitByte(b,0x44);
+	JitByte(b,0x0F);
+	JitByte(b,0x10);
+	JitByte(b,0x80 | ((dest&7)<<3) | 0x06);
+	JitInt32(b,(int32_t)(index*2*sizeof(floating_t)));
+	}
+
+/** mov r8, [rdi + 8*column] ; movupd/movsd xmm 'dest' , [r8 + rax] */
+static void JitLoadColumn(JitBufferPtr b,unsigned int prefix,unsigned int dest,size_t column)
+	{
+	JitByte(b,0x4C);
+	JitByte(b,0x8B);
+	JitByte(b,0x87);
+	JitInt32(b,(int32_t)(column*sizeof(floating_t*)));
+	JitByte(b,prefix);
+	JitByte(b,0x41 | (dest>=8?0x04:0));
+	JitByte(b,0x0F);
+	JitByte(b,0x10);
+	JitByte(b,0x04 | ((dest&7)<<3));
+	JitByte(b,0x00);
+	}
+
+/** emits the evaluation of the program for one (scalar) or two (packed) rows at [rax] */
+static void JitEmitBody(JitBufferPtr b,const ProgramPtr prog,unsigned int prefix)
+	{
+	size_t i,sp=0UL,constant_index=JIT_FIRST_CONSTANT;
+	for(i=0;i< prog->size;++i)
 		{
-		int c=fgetc(in);
-		if(c==EOF) break;
-		ungetc(c,in);
-		for(;;)
+		const InstructionPtr inst=&(prog->instructions[i]);
+		switch(inst->opcode)
 			{
-			p->data=(floating_t*)realloc(p->data,(p->size+1)*sizeof(floating_t));
-			if(p->data==NULL) THROW_ERROR("OUT OF MEMORY");	
-			if(fscanf(in,"%lf",&(p->data)[p->size])!=1)
+			case OP_CONSTANT: JitLoadConstant(b,prefix,sp++,constant_index++); break;
+			case OP_COLUMN: JitLoadColumn(b,prefix,sp++,inst->arg.column); break;
+			case OP_ADD: --sp; JitSSE(b,prefix,0x58,sp-1,sp); break;
+			case OP_MINUS: --sp; JitSSE(b,prefix,0x5C,sp-1,sp); break;
+			case OP_MUL: --sp; JitSSE(b,prefix,0x59,sp-1,sp); break;
+			case OP_DIV:
 				{
-				THROW_ERROR("BAD FLOAT");	
+				/* NAN if the divisor is zero: or the quotient with the mask (b==0) */
+				--sp;
+				JitSSE(b,JIT_PD,0x28,JIT_TMP,sp);
+				JitCompare(b,prefix,JIT_TMP,JIT_ZERO,0);
+				JitSSE(b,prefix,0x5E,sp-1,sp);
+				JitSSE(b,JIT_PD,0x56,sp-1,JIT_TMP);
+				break;
 				}
-			p->size++;
-			curr_cols++;
-			
-			c=fgetc(in);
-			if(c=='\n' || c==EOF)
+			case OP_NEGATE:
 				{
-				if(curr_cols<2)
-					{
-					fprintf(stderr,"Not enough column line %d\n",
-						SpreadSheetRows(p));
-					exit(EXIT_FAILURE);
-					}
-				else if(curr_lines == 0UL )
-					{
-					p->columns = curr_cols;
-					}
-				else if( curr_cols != p->columns)
-					{
-					fprintf(stderr,"Inconsistent column number %d\n",1+SpreadSheetRows(p));
-					exit(EXIT_FAILURE);
-					}
-				curr_lines++;
-				curr_cols=0UL;
+				JitLoadConstant(b,prefix,JIT_TMP,JIT_CONSTANT_SIGN);
+				JitSSE(b,JIT_PD,0x57,sp-1,JIT_TMP);
 				break;
 				}
-			if(c!='\t')
+			case OP_INVERT:
 				{
-				fprintf(stderr,"Expected a tab\n");
-				exit(EXIT_FAILURE);
+				JitLoadConstant(b,prefix,JIT_TMP,JIT_CONSTANT_ONE);
+				JitSSE(b,prefix,0x5E,JIT_TMP,sp-1);
+				JitCompare(b,prefix,sp-1,JIT_ZERO,0);
+				JitSSE(b,JIT_PD,0x56,sp-1,JIT_TMP);
+				break;
+				}
+			case OP_SQRT:
+				{
+				JitSSE(b,prefix,0x51,JIT_TMP,sp-1);
+				JitCompare(b,prefix,sp-1,JIT_ZERO,2);
+				JitSSE(b,JIT_PD,0x56,sp-1,JIT_TMP);
+				break;
 				}
-			ungetc(c,in);
+			default: THROW_ERROR("BOUM"); break;
 			}
 		}
+	/* movupd/movsd [rdx+rax], xmm0 */
+	JitByte(b,prefix);
+	JitByte(b,0x0F);
+	JitByte(b,0x11);
+	JitByte(b,0x04);
+	JitByte(b,0x02);
+	}
+
+/** translates the program to native code. Returns 0 if the program cannot be translated */
+static boolean_t ProgramJit(ProgramPtr prog)
+	{
+	size_t i,n_constants=JIT_FIRST_CONSTANT,loop_start,jump_tail,jump_end;
+	long page_size=sysconf(_SC_PAGESIZE);
+	JitBuffer buf;
+	void* code;
 	
-	if( SpreadSheetRows(p)==0) THROW_ERROR("Empty rows");
+	if(!prog->valid || prog->stack_depth > JIT_MAX_STACK) return 0;
 	
-	min_value = DBL_MAX;
-	max_value =-DBL_MAX;
-	p->normalized=calloc(SpreadSheetRows(p),sizeof(floating_t));
-	for(i=0;i< SpreadSheetRows(p);++i)
+	for(i=0;i< prog->size;++i)
 		{
-		floating_t v= SpreadSheetAt(p,i,SpreadSheetColumns(p)-1);
-		if(v < min_value) min_value=v;
-		if(v > max_value) max_value=v;
+		if(prog->instructions[i].opcode==OP_CONSTANT) n_constants++;
 		}
-	
-	if(max_value==min_value)
+	prog->jit_constants=(floating_t*)calloc(n_constants*2,sizeof(floating_t));
+	if(prog->jit_constants==NULL) THROW_ERROR("boum");
+	prog->jit_constants[JIT_CONSTANT_ONE*2] = prog->jit_constants[JIT_CONSTANT_ONE*2+1] = 1.0;
+	prog->jit_constants[JIT_CONSTANT_SIGN*2] = prog->jit_constants[JIT_CONSTANT_SIGN*2+1] = -0.0;
+	n_constants=JIT_FIRST_CONSTANT;
+	for(i=0;i< prog->size;++i)
 		{
-		fprintf(stderr,"Min==Max\n");
-		exit(EXIT_FAILURE);
+		if(prog->instructions[i].opcode!=OP_CONSTANT) continue;
+		prog->jit_constants[n_constants*2] = prog->jit_constants[n_constants*2+1] = prog->instructions[i].arg.constant;
+		n_constants++;
 		}
 	
-	for(i=0;i< SpreadSheetRows(p);++i)
+	/* an instruction never needs more than 32 bytes */
+	buf.capacity = 64 + 2*(32*prog->size + 8);
+	buf.capacity = ((buf.capacity + page_size - 1)/page_size)*page_size;
+	buf.size = 0UL;
+	code = mmap(NULL,buf.capacity,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS,-1,0);
+	if(code==MAP_FAILED)
 		{
-		floating_t v=SpreadSheetAt(p,i,SpreadSheetColumns(p)-1);
-		p->normalized[i] = (v-min_value)/(max_value-min_value);
+		free(prog->jit_constants);
+		prog->jit_constants=NULL;
+		return 0;
 		}
+	buf.code = (unsigned char*)code;
 	
+	JitByte(&buf,0x31);JitByte(&buf,0xC0);/* xor eax,eax */
+	JitByte(&buf,0x48);JitByte(&buf,0xC1);JitByte(&buf,0xE1);JitByte(&buf,0x03);/* shl rcx,3 */
+	JitByte(&buf,0x49);JitByte(&buf,0x89);JitByte(&buf,0xC9);/* mov r9,rcx */
+	JitByte(&buf,0x49);JitByte(&buf,0x83);JitByte(&buf,0xE1);JitByte(&buf,0xF0);/* and r9,-16 */
+	JitSSE(&buf,JIT_PD,0x57,JIT_ZERO,JIT_ZERO);/* xorpd xmm14,xmm14 */
 	
+	/* two rows at a time */
+	loop_start = buf.size;
+	JitByte(&buf,0x4C);JitByte(&buf,0x39);JitByte(&buf,0xC8);/* cmp rax,r9 */
+	JitByte(&buf,0x0F);JitByte(&buf,0x83);JitInt32(&buf,0);/* jae tail */
+	jump_tail = buf.size;
+	JitEmitBody(&buf,prog,JIT_PD);
+	JitByte(&buf,0x48);JitByte(&buf,0x83);JitByte(&buf,0xC0);JitByte(&buf,0x10);/* add rax,16 */
+	JitByte(&buf,0xE9);JitInt32(&buf,(int32_t)(loop_start-(buf.size+4)));/* jmp loop_start */
 	
-	return p;
+	/* remaining row */
+	JitPatch(&buf,jump_tail);
+	JitByte(&buf,0x48);JitByte(&buf,0x39);JitByte(&buf,0xC8);/* cmp rax,rcx */
+	JitByte(&buf,0x0F);JitByte(&buf,0x83);JitInt32(&buf,0);/* jae end */
+	jump_end = buf.size;
+	JitEmitBody(&buf,prog,JIT_SD);
+	JitPatch(&buf,jump_end);
+	JitByte(&buf,0xC3);/* ret */
+	
+	if(mprotect(code,buf.capacity,PROT_READ|PROT_EXEC)!=0)
+		{
+		munmap(code,buf.capacity);
+		free(prog->jit_constants);
+		prog->jit_constants=NULL;
+		return 0;
+		}
+	prog->jit_code = code;
+	prog->jit_size = buf.capacity;
+	return 1;
 	}
 
-void GenomeMute(GenomePtr g)
+/** returns the column pointers passed to the native code for the rows starting at 'rowIndex' */
+static const floating_t** JitColumns(const SpreadSheetPtr sheet,size_t rowIndex)
 	{
+	static __thread const floating_t** columns=NULL;
+	static __thread size_t columns_size=0UL;
 	size_t i;
-	ConfigPtr cfg=g->config;
+	if( SpreadSheetColumns(sheet) > columns_size )
+		{
+		columns = (const floating_t**)realloc(columns,SpreadSheetColumns(sheet)*sizeof(floating_t*));
+		if(columns==NULL) THROW_ERROR("BOUM");
+		columns_size = SpreadSheetColumns(sheet);
+		}
+	for(i=0;i< SpreadSheetColumns(sheet);++i)
+		{
+		columns[i] = &(SpreadSheetColumn(sheet,i)[rowIndex]);
+		}
+	return columns;
+	}
+
+/** runs the native code of the program for the 'n' rows starting at 'rowIndex' */
+static void ProgramJitRun(const ProgramPtr prog,const SpreadSheetPtr sheet,size_t rowIndex,size_t n,floating_t* values)
+	{
+	union { void* ptr; JitFunction fun; } code;
+	code.ptr = prog->jit_code;
+	code.fun(JitColumns(sheet,rowIndex),prog->jit_constants,values,n);
+	}
+
+/**
+ * compares, bit for bit (but the sign of zero), the native code with GenomeEval1 on 'jit_check_rows'
+ * rows sampled along the spreadsheet. Stops the program on error.
+ */
+static void GenomeJitCheck(GenomePtr g)
+	{
+	floating_t values[EVAL_BLOCK_SIZE];
+	const size_t nRows = SpreadSheetRows(g->config->spreadsheet);
+	size_t n_blocks = (MIN(g->config->jit_check_rows,nRows) + EVAL_BLOCK_SIZE - 1)/EVAL_BLOCK_SIZE;
+	size_t block;
+	for(block=0;block< n_blocks;++block)
+		{
+		size_t k;
+		size_t rowIndex = (block*nRows)/n_blocks;
+		size_t n = MIN(EVAL_BLOCK_SIZE,nRows-rowIndex);
+		ProgramJitRun(g->program,g->config->spreadsheet,rowIndex,n,values);
+		for(k=0;k< n;++k)
+			{
+			size_t nodeIndex=0;
+			floating_t  value=0.0;
+			boolean_t  error=0;
+			GenomeEval1(g,rowIndex+k,&nodeIndex,&value,&error);
+			/* the simplified program may change the sign of a zero */
+			if(error ? isnan(values[k]) : (memcmp((void*)&value,(void*)&values[k],sizeof(floating_t))==0 || (value==0.0 && values[k]==0.0))) continue;
+			fprintf(stderr,"JIT error row %d: expected %E got %E\n",(int)(rowIndex+k),(error?NAN:value),values[k]);
+			GenomePrint(g,stderr);
+			THROW_ERROR("JIT check failed");
+			}
+		}
+	}
+#endif /* GENPROG_HAS_JIT */
+
+/**
+ * returns the genome lowered to a postfix program. The program is cached
+ * in the genome until GenomeUncompile is called.
+ */
+ProgramPtr GenomeCompile(GenomePtr g)
+	{
+	size_t i,nodeIndex=0UL,depth=0UL;
+	ProgramPtr prog;
+	if(g->program!=NULL) return g->program;
 	
-	while(  GenomeSize(g) >0 &&
-		RANDOM_FLOAT(cfg) < cfg->probability_mutation)
+	prog=(ProgramPtr)calloc(1,sizeof(Program));
+	if(prog==NULL) THROW_ERROR("boum");
+	prog->instructions=(InstructionPtr)calloc(GenomeSize(g)+1,sizeof(Instruction));
+	if(prog->instructions==NULL) THROW_ERROR("boum");
+	
+	prog->valid = ProgramEmit(prog,g,&nodeIndex);
+	if(!prog->valid)
 		{
-		i= RANDOM_SIZE_T(cfg,g->node_count);
-		
-		float rnd= RANDOM_FLOAT(cfg);
-		if( rnd < 0.05 )
+		prog->size = 0UL;
+		prog->node_count = GenomeSize(g);
+		}
+	else
+		{
+		prog->node_count = nodeIndex+1;
+		}
+	
+	for(i=0;i< prog->size;++i)
+		{
+		switch(OpCodeArity(prog->instructions[i].opcode))
 			{
-			//insert
-			size_t j,insert_size= 1 + RANDOM_SIZE_T( cfg , 5); 
-			g->nodes = (NodePtr)realloc(g->nodes, (g->node_count + insert_size)*sizeof(Node));
-			if(g->nodes==NULL) THROW_ERROR("boum");
-			memmove(
-				(void*)&g->nodes[i+insert_size],//dest
-				(void*)&g->nodes[i],//src
-				(GenomeSize(g) - i)*sizeof(Node)
-				);
-			for(j=0;j< insert_size;++j)
-				{
-				NodeInit(cfg,&(g->nodes[i+j]));
-				}
-			g->node_count+=insert_size;
+			case 0: depth++; break;
+			case 2: depth--; break;
+			default: break;
 			}
-		else if(rnd< 0.1)
+		if(depth > prog->stack_depth) prog->stack_depth = depth;
+		}
+	if(prog->valid && depth!=1UL) THROW_ERROR("bad stack");
+	
+	g->program = prog;
+#ifdef GENPROG_HAS_JIT
+	if( g->config->use_jit &&
+		SpreadSheetRows(g->config->spreadsheet) >= g->config->jit_min_rows &&
+		ProgramJit(prog) &&
+		g->config->jit_check_rows > 0UL)
+		{
+		GenomeJitCheck(g);
+		}
+#endif
+	return prog;
+	}
+
+/** releases the compiled program, must be called each time the nodes are modified */
+void GenomeUncompile(GenomePtr g)
+	{
+	if(g->program==NULL) return;
+#ifdef GENPROG_HAS_JIT
+	if(g->program->jit_code!=NULL) munmap(g->program->jit_code,g->program->jit_size);
+#endif
+	free(g->program->jit_constants);
+	free(g->program->instructions);
+	free(g->program);
+	g->program=NULL;
+	}
+
+/**
+ * runs the (valid) program for the 'n' rows starting at 'rowIndex'.
+ * The stack must hold EVAL_BLOCK_SIZE floats for each level of prog->stack_depth.
+ * On exit, the result is stored in the first 'n' items of the stack.
+ * An invalid row is flagged with NAN.
+ */
+static void ProgramEvalBlock(
+		const ProgramPtr prog,
+		const SpreadSheetPtr sheet,
+		const size_t rowIndex,
+		const size_t n,
+		floating_t* stack
+		)
+	{
+	size_t i,k;
+	size_t sp=0UL;/* number of values on the stack */
+#define STACK_AT(idx) (&stack[(idx)*EVAL_BLOCK_SIZE])
+	for(i=0;i< prog->size;++i)
+		{
+		const InstructionPtr inst=&(prog->instructions[i]);
+		switch(inst->opcode)
 			{
-			//delete
-			size_t del_size= 1 + RANDOM_SIZE_T( cfg , 5); 
-			if( i+del_size > GenomeSize(g))
+			case OP_CONSTANT:
 				{
-				del_size = GenomeSize(g) - i;
+				floating_t* dest = STACK_AT(sp++);
+				for(k=0;k< n;++k) dest[k] = inst->arg.constant;
+				break;
 				}
-				
-			memmove(
-				(void*)&g->nodes[i],//dest
-				(void*)&g->nodes[i+del_size],//src
-				(GenomeSize(g) - (i+del_size))*sizeof(Node)
-				);
-				
-			g->node_count -= del_size;
-				
+			case OP_COLUMN:
+				{
+				memcpy((void*)STACK_AT(sp++),
+					(const void*)&(SpreadSheetColumn(sheet,inst->arg.column)[rowIndex]),
+					n*sizeof(floating_t)
+					);
+				break;
+				}
+			case OP_ADD: --sp; _plus_array(STACK_AT(sp-1),STACK_AT(sp-1),STACK_AT(sp),n); break;
+			case OP_MINUS: --sp; _minus_array(STACK_AT(sp-1),STACK_AT(sp-1),STACK_AT(sp),n); break;
+			case OP_MUL: --sp; _mul_array(STACK_AT(sp-1),STACK_AT(sp-1),STACK_AT(sp),n); break;
+			case OP_DIV: --sp; _div_array(STACK_AT(sp-1),STACK_AT(sp-1),STACK_AT(sp),n); break;
+			case OP_NEGATE: _negate_array(STACK_AT(sp-1),STACK_AT(sp-1),NULL,n); break;
+			case OP_INVERT: _invert_array(STACK_AT(sp-1),STACK_AT(sp-1),NULL,n); break;
+			case OP_SQRT: _sqrt_array(STACK_AT(sp-1),STACK_AT(sp-1),NULL,n); break;
+			default: THROW_ERROR("BOUM"); break;
 			}
-		else if(rnd < 0.2)
+		}
+#undef STACK_AT
+	}
+
+/** evaluates the genome for the 'n' rows of 'sheet' starting at 'rowIndex'. Invalid rows are flagged with NAN */
+static void GenomeEvalRows(GenomePtr g,const SpreadSheetPtr sheet,const size_t rowIndex,const size_t n,floating_t* values)
+	{
+	ProgramPtr prog = GenomeCompile(g);
+#ifdef GENPROG_HAS_JIT
+	if(prog->jit_code!=NULL)
+		{
+		ProgramJitRun(prog,sheet,rowIndex,n,values);
+		return;
+		}
+#endif
+	if(prog->valid)
+		{
+		ProgramEvalBlock(prog,sheet,rowIndex,n,values);
+		}
+	else
+		{
+		size_t i;
+		for(i=0;i< n;++i) values[i]=NAN;
+		}
+	}
+
+/** returns a stack large enough to run the program of this genome */
+static floating_t* GenomeEvalStack(GenomePtr g)
+	{
+	ProgramPtr prog = GenomeCompile(g);
+	return EvalWorkspace((prog->stack_depth>0UL?prog->stack_depth:1UL)*EVAL_BLOCK_SIZE);
+	}
+
+/** FNV-1a hash of the 64 bits of 'n' nodes, least significant byte first */
+static uint64_t NodesHash(const Node* nodes,size_t n)
+	{
+	size_t i,k;
+	uint64_t h=14695981039346656037ULL;
+	for(i=0;i< n;++i)
+		{
+		for(k=0;k< sizeof(Node);++k)
 			{
-			//silent mutation
-			size_t insert_size=2; 
-			g->nodes = (NodePtr)realloc(g->nodes, (g->node_count + insert_size)*sizeof(Node));
-			if(g->nodes==NULL) THROW_ERROR("boum");
-			
-			
-			memmove(
-				(void*)&g->nodes[i+1+insert_size],//dest
-				(void*)&g->nodes[i+1],//src
-				(GenomeSize(g) - (i+1))*sizeof(Node)
-				);
-			memcpy(
-				(void*)&g->nodes[i+1],//dest
-				(void*)&g->nodes[i],//src
-				sizeof(Node)
-				);
-			memcpy(
-				(void*)&g->nodes[i+2],//dest
-				(void*)&g->nodes[i],//src
-				sizeof(Node)
-				);
-			g->node_count+=insert_size;
-			
-			switch(  RANDOM_SIZE_T( cfg , 4) )
+			h = (h ^ ((nodes[i].bits>>(8*k)) & 0xFF)) * 1099511628211ULL;
+			}
+		}
+	return h;
+	}
+
+static boolean_t NodesEquals(const Node* n1,const Node* n2,size_t n)
+	{
+	return memcmp((const void*)n1,(const void*)n2,n*sizeof(Node))==0;
+	}
+
+/**
+ * fills sizes[i] with the number of nodes of the subtree starting at node 'i',
+ * or NPOS if this subtree is truncated. Nodes are scanned backward, the
+ * sizes of the complete subtrees following a node being kept on a stack.
+ * 'sizes' and 'stack' must hold GenomeSize(g) items.
+ */
+static void GenomeSubtreeSizes(const GenomePtr g,size_t* sizes,size_t* stack)
+	{
+	size_t i=GenomeSize(g),sp=0UL;
+	while(i>0UL)
+		{
+		NodePtr node=&(g->nodes[--i]);
+		if(NodeType(node)==OPERATOR)
+			{
+			size_t k,n=OperatorListAt(g->config->operators,NodeOperator(node))->num_children;
+			sizes[i]=1UL;
+			for(k=0;k< n;++k)
 				{
-				case 0: {
-					g->nodes[i].type=OPERATOR;
-					g->nodes[i].core.operator= cfg->operators->plus->index;
-					
-					g->nodes[i+2].type=CONSTANT;
-					g->nodes[i+2].core.constant= 0.0;
-					break;
-					};
-				case 1: {
-					g->nodes[i].type=OPERATOR;
-					g->nodes[i].core.operator= cfg->operators->minus->index;
-					
-					g->nodes[i+2].type=CONSTANT;
-					g->nodes[i+2].core.constant= 0.0;
-					break;
-					};
-				case 2: {
-					g->nodes[i].type=OPERATOR;
-					g->nodes[i].core.operator= cfg->operators->mul->index;
-					
-					g->nodes[i+2].type=CONSTANT;
-					g->nodes[i+2].core.constant= 1.0;
+				if(sp==0UL || stack[sp-1]==NPOS)
+					{
+					sizes[i]=NPOS;
 					break;
-					};
-				default:
+					}
+				sizes[i] += stack[--sp];
+				}
+			}
+		else
+			{
+			sizes[i]=1UL;
+			}
+		stack[sp++]=sizes[i];
+		}
+	}
+
+/**
+ * Subtree cache. The output of each subtree (but the columns) over all the
+ * rows is kept in memory and shared by all the genomes containing the same
+ * sequence of nodes. Entries are released in least-recently-used order
+ * when the memory used by the cache is greater than max_bytes. An entry
+ * being read by a thread (refcount>0) is never released.
+ */
+typedef struct subtree_entry_t
+	{
+	uint64_t hash;
+	/* key */
+	NodePtr nodes;
+	size_t node_count;
+	/* output for each row */
+	floating_t* values;
+	size_t refcount;
+	/* next entry in the same bucket */
+	struct subtree_entry_t* next;
+	/* LRU list, most recent first */
+	struct subtree_entry_t* lru_prev;
+	struct subtree_entry_t* lru_next;
+	} SubtreeEntry,*SubtreeEntryPtr;
+
+typedef struct subtree_cache_t
+	{
+	pthread_mutex_t lock;
+	SubtreeEntryPtr* buckets;
+	/* number of buckets, a power of 2 */
+	size_t n_buckets;
+	SubtreeEntryPtr lru_head;
+	SubtreeEntryPtr lru_tail;
+	size_t rows;
+	size_t bytes;
+	size_t max_bytes;
+	unsigned long hits;
+	unsigned long misses;
+	unsigned long evictions;
+	} SubtreeCache,*SubtreeCachePtr;
+
+static SubtreeCachePtr SubtreeCacheNew(size_t max_bytes,size_t rows)
+	{
+	SubtreeCachePtr c=(SubtreeCachePtr)calloc(1,sizeof(SubtreeCache));
+	if(c==NULL) THROW_ERROR("boum");
+	c->max_bytes = max_bytes;
+	c->rows = rows;
+	c->n_buckets = 1UL;
+	/* about one bucket per possible entry */
+	while(c->n_buckets < max_bytes/(rows*sizeof(floating_t)+1) && c->n_buckets < (1UL<<20)) c->n_buckets*=2;
+	c->buckets = (SubtreeEntryPtr*)calloc(c->n_buckets,sizeof(SubtreeEntryPtr));
+	if(c->buckets==NULL) THROW_ERROR("boum");
+	pthread_mutex_init(&c->lock,NULL);
+	return c;
+	}
+
+static void SubtreeEntryFree(SubtreeEntryPtr e)
+	{
+	free(e->nodes);
+	free(e->values);
+	free(e);
+	}
+
+static void SubtreeCacheFree(SubtreeCachePtr c)
+	{
+	SubtreeEntryPtr e;
+	if(c==NULL) return;
+	e = c->lru_head;
+	while(e!=NULL)
+		{
+		SubtreeEntryPtr next=e->lru_next;
+		SubtreeEntryFree(e);
+		e=next;
+		}
+	pthread_mutex_destroy(&c->lock);
+	free(c->buckets);
+	free(c);
+	}
+
+static size_t SubtreeEntryBytes(const SubtreeCachePtr c,const SubtreeEntryPtr e)
+	{
+	return sizeof(SubtreeEntry) + e->node_count*sizeof(Node) + c->rows*sizeof(floating_t);
+	}
+
+static void SubtreeCacheUnlink(SubtreeCachePtr c,SubtreeEntryPtr e)
+	{
+	if(e->lru_prev!=NULL) e->lru_prev->lru_next = e->lru_next; else c->lru_head = e->lru_next;
+	if(e->lru_next!=NULL) e->lru_next->lru_prev = e->lru_prev; else c->lru_tail = e->lru_prev;
+	e->lru_prev = e->lru_next = NULL;
+	}
+
+static void SubtreeCachePushFront(SubtreeCachePtr c,SubtreeEntryPtr e)
+	{
+	e->lru_prev = NULL;
+	e->lru_next = c->lru_head;
+	if(c->lru_head!=NULL) c->lru_head->lru_prev = e; else c->lru_tail = e;
+	c->lru_head = e;
+	}
+
+/** releases the least recently used entries until the cache fits in max_bytes. lock must be held */
+static void SubtreeCacheEvict(SubtreeCachePtr c)
+	{
+	SubtreeEntryPtr e=c->lru_tail;
+	while(c->bytes > c->max_bytes && e!=NULL)
+		{
+		SubtreeEntryPtr prev=e->lru_prev;
+		if(e->refcount==0UL)
+			{
+			SubtreeEntryPtr* p=&(c->buckets[e->hash & (c->n_buckets-1)]);
+			while(*p!=e) p=&((*p)->next);
+			*p = e->next;
+			SubtreeCacheUnlink(c,e);
+			c->bytes -= SubtreeEntryBytes(c,e);
+			c->evictions++;
+			SubtreeEntryFree(e);
+			}
+		e=prev;
+		}
+	}
+
+/** returns the entry holding the output of these nodes with refcount incremented, or NULL */
+static SubtreeEntryPtr SubtreeCacheGet(SubtreeCachePtr c,const Node* nodes,size_t n,uint64_t hash)
+	{
+	SubtreeEntryPtr e;
+	pthread_mutex_lock(&c->lock);
+	e = c->buckets[hash & (c->n_buckets-1)];
+	while(e!=NULL)
+		{
+		if(e->hash==hash && e->node_count==n && NodesEquals(e->nodes,nodes,n)) break;
+		e=e->next;
+		}
+	if(e!=NULL)
+		{
+		c->hits++;
+		e->refcount++;
+		SubtreeCacheUnlink(c,e);
+		SubtreeCachePushFront(c,e);
+		}
+	else
+		{
+		c->misses++;
+		}
+	pthread_mutex_unlock(&c->lock);
+	return e;
+	}
+
+/**
+ * inserts the output 'values' of these nodes. The cache takes the ownership of 'values'.
+ * returns the entry holding the output with refcount incremented.
+ */
+static SubtreeEntryPtr SubtreeCachePut(SubtreeCachePtr c,const Node* nodes,size_t n,uint64_t hash,floating_t* values)
+	{
+	SubtreeEntryPtr e=(SubtreeEntryPtr)calloc(1,sizeof(SubtreeEntry));
+	SubtreeEntryPtr other;
+	if(e==NULL) THROW_ERROR("boum");
+	e->nodes = (NodePtr)malloc(n*sizeof(Node));
+	if(e->nodes==NULL) THROW_ERROR("boum");
+	memcpy((void*)e->nodes,(const void*)nodes,n*sizeof(Node));
+	e->node_count = n;
+	e->hash = hash;
+	e->values = values;
+	e->refcount = 1UL;
+	pthread_mutex_lock(&c->lock);
+	/* another thread may have computed the same subtree */
+	other = c->buckets[hash & (c->n_buckets-1)];
+	while(other!=NULL)
+		{
+		if(other->hash==hash && other->node_count==n && NodesEquals(other->nodes,nodes,n)) break;
+		other=other->next;
+		}
+	if(other!=NULL)
+		{
+		other->refcount++;
+		pthread_mutex_unlock(&c->lock);
+		SubtreeEntryFree(e);
+		return other;
+		}
+	e->next = c->buckets[hash & (c->n_buckets-1)];
+	c->buckets[hash & (c->n_buckets-1)] = e;
+	SubtreeCachePushFront(c,e);
+	c->bytes += SubtreeEntryBytes(c,e);
+	SubtreeCacheEvict(c);
+	pthread_mutex_unlock(&c->lock);
+	return e;
+	}
+
+static void SubtreeCacheRelease(SubtreeCachePtr c,SubtreeEntryPtr e)
+	{
+	pthread_mutex_lock(&c->lock);
+	e->refcount--;
+	SubtreeCacheEvict(c);
+	pthread_mutex_unlock(&c->lock);
+	}
+
+/**
+ * returns the output over all the rows of the (complete) subtree starting at
+ * node 'i'. If the returned array belongs to the cache, *entry is set and must
+ * be released with SubtreeCacheRelease.
+ */
+static const floating_t* SubtreeEval(GenomePtr g,SubtreeCachePtr c,const size_t* sizes,size_t i,SubtreeEntryPtr* entry)
+	{
+	const size_t nRows=SpreadSheetRows(g->config->spreadsheet);
+	NodePtr node=&(g->nodes[i]);
+	uint64_t hash;
+	floating_t* values;
+	*entry=NULL;
+	if(NodeType(node)==COLUMN)
+		{
+		return SpreadSheetColumn(g->config->spreadsheet,NodeColumn(node));
+		}
+	hash = NodesHash(node,sizes[i]);
+	*entry = SubtreeCacheGet(c,node,sizes[i],hash);
+	if(*entry!=NULL) return (*entry)->values;
+	
+	values = (floating_t*)malloc(nRows*sizeof(floating_t));
+	if(values==NULL) THROW_ERROR("boum");
+	if(NodeType(node)==CONSTANT)
+		{
+		size_t k;
+		for(k=0;k< nRows;++k) values[k]=NodeConstant(node);
+		}
+	else
+		{
+		size_t k,child=i+1;
+		const floating_t* args[MAX_ARITY];
+		SubtreeEntryPtr entries[MAX_ARITY];
+		OperatorPtr op = OperatorListAt(g->config->operators,NodeOperator(node));
+		for(k=0;k< op->num_children;++k)
+			{
+			args[k] = SubtreeEval(g,c,sizes,child,&entries[k]);
+			child += sizes[child];
+			}
+		op->eval_array(values,args[0],(op->num_children>1?args[1]:args[0]),nRows);
+		for(k=0;k< op->num_children;++k)
+			{
+			if(entries[k]!=NULL) SubtreeCacheRelease(c,entries[k]);
+			}
+		}
+	*entry = SubtreeCachePut(c,node,sizes[i],hash,values);
+	return (*entry)->values;
+	}
+
+/**
+ * Selection of the children surviving a generation: the 'capacity' best
+ * children, ordered by GenomeCompare and then by index (the rank of their
+ * pair of parents), kept in a bounded max-heap while they are created.
+ * A child equal to a selected one is not kept twice: only the one with the
+ * lowest index is kept. Equal children are found with a hash of their nodes.
+ * A child that doesn't make it is freed right away.
+ * As the selected children are distinct, a child whose partial error is
+ * already greater than the worst of them can't survive: see SelectionThreshold.
+ */
+typedef struct selected_genome_t
+	{
+	GenomePtr genome;
+	size_t index;
+	uint64_t hash;
+	/* next slot in the same bucket, or NPOS */
+	size_t next;
+	/* position in the heap */
+	size_t heap_pos;
+	} SelectedGenome,*SelectedGenomePtr;
+
+typedef struct selection_t
+	{
+	pthread_mutex_t lock;
+	/* 'capacity' slots, the 'size' first ones are used */
+	SelectedGenomePtr slots;
+	/* max-heap of slots, the worst child first */
+	size_t* heap;
+	size_t size;
+	size_t capacity;
+	/* first slot of each bucket, or NPOS. The number of buckets is a power of 2 */
+	size_t* buckets;
+	size_t n_buckets;
+	/* fitness of the worst child when the heap is full, INFINITY otherwise */
+	floating_t threshold;
+	} Selection,*SelectionPtr;
+
+static SelectionPtr SelectionNew(size_t capacity)
+	{
+	size_t i;
+	SelectionPtr c=(SelectionPtr)calloc(1,sizeof(Selection));
+	if(c==NULL) THROW_ERROR("boum");
+	c->capacity = capacity;
+	c->n_buckets = 1UL;
+	while(c->n_buckets < 2*capacity) c->n_buckets*=2;
+	c->slots = (SelectedGenomePtr)calloc(MAX(capacity,1UL),sizeof(SelectedGenome));
+	c->heap = (size_t*)calloc(MAX(capacity,1UL),sizeof(size_t));
+	c->buckets = (size_t*)malloc(c->n_buckets*sizeof(size_t));
+	if(c->slots==NULL || c->heap==NULL || c->buckets==NULL) THROW_ERROR("boum");
+	for(i=0;i< c->n_buckets;++i) c->buckets[i]=NPOS;
+	c->threshold = INFINITY;
+	pthread_mutex_init(&c->lock,NULL);
+	return c;
+	}
+
+/** forgets the selected children, without freeing them */
+static void SelectionClear(SelectionPtr c)
+	{
+	size_t i;
+	for(i=0;i< c->n_buckets;++i) c->buckets[i]=NPOS;
+	c->size=0UL;
+	c->threshold = INFINITY;
+	}
+
+static void SelectionFree(SelectionPtr c)
+	{
+	size_t i;
+	if(c==NULL) return;
+	for(i=0;i< c->size;++i) GenomeFree(c->slots[i].genome);
+	pthread_mutex_destroy(&c->lock);
+	free(c->slots);
+	free(c->heap);
+	free(c->buckets);
+	free(c);
+	}
+
+/** returns the fitness above which a child cannot survive */
+static floating_t SelectionThreshold(SelectionPtr c)
+	{
+	floating_t t;
+	if(c==NULL) return INFINITY;
+	__atomic_load(&c->threshold,&t,__ATOMIC_RELAXED);
+	return t;
+	}
+
+static int SelectedGenomeCompare(const SelectedGenome* s1,const SelectedGenome* s2)
+	{
+	int i = GenomeCompare(s1->genome,s2->genome);
+	if(i!=0) return i;
+	return s1->index < s2->index ? -1 : (s1->index > s2->index ? 1 : 0);
+	}
+
+static int _SelectedGenomeCompare(const void* a,const void* b)
+	{
+	return SelectedGenomeCompare((const SelectedGenome*)a,(const SelectedGenome*)b);
+	}
+
+static void SelectionHeapSet(SelectionPtr c,size_t pos,size_t slot)
+	{
+	c->heap[pos] = slot;
+	c->slots[slot].heap_pos = pos;
+	}
+
+static void SelectionSiftUp(SelectionPtr c,size_t pos)
+	{
+	size_t slot = c->heap[pos];
+	while(pos>0UL && SelectedGenomeCompare(&c->slots[c->heap[(pos-1)/2]],&c->slots[slot]) < 0)
+		{
+		SelectionHeapSet(c,pos,c->heap[(pos-1)/2]);
+		pos = (pos-1)/2;
+		}
+	SelectionHeapSet(c,pos,slot);
+	}
+
+static void SelectionSiftDown(SelectionPtr c,size_t pos)
+	{
+	size_t slot = c->heap[pos];
+	for(;;)
+		{
+		size_t child = 2*pos+1;
+		if(child >= c->size) break;
+		if(child+1 < c->size && SelectedGenomeCompare(&c->slots[c->heap[child+1]],&c->slots[c->heap[child]]) > 0) child++;
+		if(SelectedGenomeCompare(&c->slots[c->heap[child]],&c->slots[slot]) <= 0) break;
+		SelectionHeapSet(c,pos,c->heap[child]);
+		pos = child;
+		}
+	SelectionHeapSet(c,pos,slot);
+	}
+
+static void SelectionLink(SelectionPtr c,size_t slot)
+	{
+	size_t b = c->slots[slot].hash & (c->n_buckets-1);
+	c->slots[slot].next = c->buckets[b];
+	c->buckets[b] = slot;
+	}
+
+static void SelectionUnlink(SelectionPtr c,size_t slot)
+	{
+	size_t* p = &(c->buckets[c->slots[slot].hash & (c->n_buckets-1)]);
+	while(*p!=slot)
+		{
+		if(*p==NPOS) THROW_ERROR("boum");
+		p = &(c->slots[*p].next);
+		}
+	*p = c->slots[slot].next;
+	}
+
+/**
+ * offers the (evaluated, not bad) child 'g' created by the pair of parents 'index'.
+ * returns 1 if the child was selected, 0 if it was freed.
+ */
+static boolean_t SelectionAdd(SelectionPtr c,GenomePtr g,size_t index)
+	{
+	boolean_t selected=1;
+	size_t slot;
+	SelectedGenome candidate;
+	candidate.genome = g;
+	candidate.index = index;
+	candidate.hash = NodesHash(g->nodes,g->node_count);
+	candidate.next = NPOS;
+	pthread_mutex_lock(&c->lock);
+	
+	for(slot=c->buckets[candidate.hash & (c->n_buckets-1)]; slot!=NPOS; slot=c->slots[slot].next)
+		{
+		if(c->slots[slot].hash==candidate.hash && GenomeEquals(c->slots[slot].genome,g)) break;
+		}
+	if(slot!=NPOS)
+		{
+		/* already selected: keep the lowest index */
+		SelectedGenomePtr dup=&(c->slots[slot]);
+		if(index < dup->index)
+			{
+			GenomeFree(dup->genome);
+			dup->genome = g;
+			dup->index = index;
+			SelectionSiftDown(c,dup->heap_pos);
+			}
+		else
+			{
+			GenomeFree(g);
+			selected=0;
+			}
+		}
+	else if(c->size < c->capacity)
+		{
+		slot = c->size++;
+		c->slots[slot] = candidate;
+		SelectionLink(c,slot);
+		c->heap[c->size-1] = slot;
+		SelectionSiftUp(c,c->size-1);
+		}
+	else if(c->size>0UL && SelectedGenomeCompare(&candidate,&c->slots[c->heap[0]]) < 0)
+		{
+		/* replaces the worst */
+		slot = c->heap[0];
+		SelectionUnlink(c,slot);
+		GenomeFree(c->slots[slot].genome);
+		c->slots[slot] = candidate;
+		c->slots[slot].heap_pos = 0UL;
+		SelectionLink(c,slot);
+		SelectionSiftDown(c,0UL);
+		}
+	else
+		{
+		GenomeFree(g);
+		selected=0;
+		}
+	if(c->size>0UL && c->size == c->capacity)
+		{
+		__atomic_store(&c->threshold,&(c->slots[c->heap[0]].genome->fitness),__ATOMIC_RELAXED);
+		}
+	pthread_mutex_unlock(&c->lock);
+	return selected;
+	}
+
+/** moves the selected children, best first, to the end of 'gen' and clears the selection */
+static void SelectionToGeneration(SelectionPtr c,GenerationPtr gen)
+	{
+	size_t i;
+	qsort((void*)c->slots,c->size,sizeof(SelectedGenome),_SelectedGenomeCompare);
+	for(i=0;i< c->size;++i)
+		{
+		GenerationAdd(gen,c->slots[i].genome);
+		}
+	SelectionClear(c);
+	}
+
+/**
+ * sums of the evaluation of a genome over some rows, see GenomeEval.
+ * Without normalization: the error. With normalization: number of valid
+ * rows and sums of the shifted values.
+ */
+typedef struct eval_sums_t
+	{
+	floating_t min_value;
+	floating_t max_value;
+	size_t num_errors;
+	size_t max_errors;
+	floating_t sse;
+	size_t k;
+	floating_t shift,sw,sw2,swt,st,stt;
+	boolean_t rejected;
+	/* number of rows computed by the program, see --bench */
+	size_t rows;
+	} EvalSums;
+
+static void EvalSumsInit(EvalSums* sums,GenomePtr g,const SpreadSheetPtr sheet)
+	{
+	memset((void*)sums,0,sizeof(EvalSums));
+	sums->min_value= DBL_MAX;
+	sums->max_value=-DBL_MAX;
+	sums->max_errors=(size_t)(g->config->max_fraction_of_errors)*SpreadSheetRows(sheet);
+	}
+
+/** true if the genome is known to be bad: the next rows can be skipped */
+static boolean_t EvalSumsDone(const EvalSums* sums)
+	{
+	return sums->num_errors > sums->max_errors || sums->rejected;
+	}
+
+/**
+ * adds the rows [begin,end) of 'sheet' to the sums. 'all_values' is the
+ * output of the genome over all the rows, or NULL. See GenomeEval for the cutoff.
+ */
+static void GenomeEvalRange(GenomePtr g,const SpreadSheetPtr sheet,EvalSums* sums,size_t begin,size_t end,const floating_t* all_values,SelectionPtr cutoff)
+	{
+	size_t rowIndex;
+	const boolean_t normalize = g->config->normalize_data;
+	const floating_t* target = (normalize ?
+		sheet->normalized :
+		SpreadSheetColumn(sheet,SpreadSheetColumns(sheet)-1)
+		);
+	floating_t* values = GenomeEvalStack(g);
+	
+	for(rowIndex=begin;
+		rowIndex< end && !EvalSumsDone(sums);
+		rowIndex+=EVAL_BLOCK_SIZE)
+		{
+		size_t i;
+		size_t n = MIN(EVAL_BLOCK_SIZE, end-rowIndex);
+		const floating_t* t = &target[rowIndex];
+		if(all_values!=NULL)
+			{
+			values = (floating_t*)&all_values[rowIndex];
+			}
+		else
+			{
+			GenomeEvalRows(g,sheet,rowIndex,n,values);
+			sums->rows += n;
+			}
+		
+		for(i=0;i< n;++i)
+			{
+			floating_t value = values[i];
+			if(isnan(value))
+				{
+				sums->num_errors++;
+				if( sums->num_errors>sums->max_errors )
 					{
-					
-					g->nodes[i].type=OPERATOR;
-					g->nodes[i].core.operator= cfg->operators->mul->index;
-					
-					g->nodes[i+2].type=CONSTANT;
-					g->nodes[i+2].core.constant= 1.0;
-					
+					//fprintf(stderr,"too many errors\n");
 					break;
 					}
+				continue;
+				}
+			if(value < sums->min_value) sums->min_value = value;
+			if(value > sums->max_value) sums->max_value = value;
+			if(!normalize)
+				{
+				floating_t diff = value - t[i];
+				sums->sse += diff*diff;
+				}
+			else
+				{
+				floating_t w;
+				if(sums->k==0UL) sums->shift=value;
+				w = value - sums->shift;
+				sums->k++;
+				sums->sw += w;
+				sums->sw2 += w*w;
+				sums->swt += w*t[i];
+				sums->st += t[i];
+				sums->stt += t[i]*t[i];
 				}
 			}
-		else if( rnd < 0.3)
+		/* the error can only increase: this genome cannot survive */
+		if(!normalize && sums->sse > SelectionThreshold(cutoff))
+			{
+			sums->rejected=1;
+			}
+		}
+	}
+
+/** sets the fitness of the genome from the sums of all the rows. returns 0 if the genome was rejected */
+static boolean_t EvalSumsFinish(GenomePtr g,const EvalSums* sums)
+	{
+	__atomic_fetch_add(&(g->config->genome_evaluations),1UL,__ATOMIC_RELAXED);
+	__atomic_fetch_add(&(g->config->node_evaluations),(uint64_t)(sums->rows*g->program->size),__ATOMIC_RELAXED);
+	if(sums->max_value==sums->min_value || sums->num_errors>sums->max_errors || sums->rejected)
+		{
+		g->bad_flag=1;
+		g->fitness=NAN;
+		}
+	else if(!g->config->normalize_data)
+		{
+		g->fitness=sums->sse;
+		}
+	else
+		{
+		const floating_t r = sums->max_value-sums->min_value;
+		const floating_t a = sums->min_value-sums->shift;
+		g->fitness = (sums->sw2 - 2.0*a*sums->sw + sums->k*a*a)/(r*r) - 2.0*(sums->swt - a*sums->st)/r + sums->stt;
+		/* rounding errors */
+		if(g->fitness < 0.0) g->fitness=0.0;
+		//fprintf(stderr,"fitness =%f\n",g->fitness);
+		}
+	return !sums->rejected;
+	}
+
+/**
+ * computes the fitness of the genome on the rows of 'sheet', in a single pass
+ * over the rows. If cutoff is not NULL and the data are not normalized, the
+ * evaluation stops as soon as the sum of the squared errors is greater than
+ * the threshold of the cutoff: the genome is then flagged as bad.
+ * returns 0 if the evaluation was stopped this way.
+ *
+ * With normalize_data, the values are scaled to [0,1] using their min and max,
+ * which are only known at the end. The error is then derived from the sums
+ * below. The values are shifted by the first valid value to limit the
+ * cancellation: with w=v-shift, a=min-shift, r=max-min and t the normalized target,
+ * sum(((w-a)/r-t)^2) = (sw2 - 2a.sw + k.a^2)/r^2 - 2(swt - a.st)/r + stt
+ */
+static boolean_t GenomeEval(GenomePtr g,const SpreadSheetPtr sheet,SelectionPtr cutoff)
+	{
+	EvalSums sums;
+	boolean_t accepted;
+	const size_t nRows = SpreadSheetRows(sheet);
+	/* output of the whole tree when the subtree cache is used */
+	const floating_t* all_values=NULL;
+	SubtreeEntryPtr root_entry=NULL;
+	
+	if( nRows==0) THROW_ERROR("BOUM");
+	
+	/* truncated tree: no need to look at the rows */
+	if( !g->program->valid )
+		{
+		g->bad_flag=1;
+		g->fitness=NAN;
+		return 1;
+		}
+	
+	if( g->config->subtree_cache!=NULL && sheet==g->config->spreadsheet)
+		{
+		size_t* sizes=(size_t*)malloc(2*GenomeSize(g)*sizeof(size_t));
+		if(sizes==NULL) THROW_ERROR("BOUM");
+		GenomeSubtreeSizes(g,sizes,&sizes[GenomeSize(g)]);
+		all_values = SubtreeEval(g,g->config->subtree_cache,sizes,0UL,&root_entry);
+		free(sizes);
+		}
+	
+	EvalSumsInit(&sums,g,sheet);
+	GenomeEvalRange(g,sheet,&sums,0UL,nRows,all_values,cutoff);
+	accepted = EvalSumsFinish(g,&sums);
+	if(root_entry!=NULL) SubtreeCacheRelease(g->config->subtree_cache,root_entry);
+	return accepted;
+	}
+
+/**
+ * Fitness cache. The fitness only depends on the nodes used by the tree
+ * (see Program.node_count), so the key is this sequence of nodes, without
+ * the trailing introns. The cache is direct-mapped: a new entry replaces
+ * the previous one in the same slot.
+ */
+typedef struct fitness_cache_entry_t
+	{
+	uint64_t hash;
+	/* key, NULL if the slot is empty */
+	NodePtr nodes;
+	size_t node_count;
+	floating_t fitness;
+	boolean_t bad_flag;
+	} FitnessCacheEntry,*FitnessCacheEntryPtr;
+
+typedef struct fitness_cache_t
+	{
+	pthread_mutex_t lock;
+	FitnessCacheEntryPtr entries;
+	/* number of entries, a power of 2 */
+	size_t size;
+	unsigned long hits;
+	unsigned long misses;
+	unsigned long evictions;
+	} FitnessCache,*FitnessCachePtr;
+
+static FitnessCachePtr FitnessCacheNew(size_t size)
+	{
+	size_t n=1UL;
+	FitnessCachePtr c=(FitnessCachePtr)calloc(1,sizeof(FitnessCache));
+	if(c==NULL) THROW_ERROR("boum");
+	while(n < size) n*=2;
+	c->size = n;
+	c->entries = (FitnessCacheEntryPtr)calloc(n,sizeof(FitnessCacheEntry));
+	if(c->entries==NULL) THROW_ERROR("boum");
+	pthread_mutex_init(&c->lock,NULL);
+	return c;
+	}
+
+static void FitnessCacheFree(FitnessCachePtr c)
+	{
+	size_t i;
+	if(c==NULL) return;
+	for(i=0;i< c->size;++i) free(c->entries[i].nodes);
+	pthread_mutex_destroy(&c->lock);
+	free(c->entries);
+	free(c);
+	}
+
+/** sets the fitness of the genome if it is in the cache. returns 1 on success */
+static boolean_t FitnessCacheGet(FitnessCachePtr c,GenomePtr g,uint64_t hash,size_t n)
+	{
+	boolean_t found=0;
+	FitnessCacheEntryPtr e = &(c->entries[hash & (c->size-1)]);
+	pthread_mutex_lock(&c->lock);
+	if(e->nodes!=NULL &&
+		e->hash==hash &&
+		e->node_count==n &&
+		NodesEquals(e->nodes,g->nodes,n))
+		{
+		g->fitness = e->fitness;
+		g->bad_flag = e->bad_flag;
+		found=1;
+		c->hits++;
+		}
+	else
+		{
+		c->misses++;
+		}
+	pthread_mutex_unlock(&c->lock);
+	return found;
+	}
+
+static void FitnessCachePut(FitnessCachePtr c,const GenomePtr g,uint64_t hash,size_t n)
+	{
+	NodePtr nodes=(NodePtr)malloc(n*sizeof(Node));
+	FitnessCacheEntryPtr e = &(c->entries[hash & (c->size-1)]);
+	if(nodes==NULL) THROW_ERROR("boum");
+	memcpy((void*)nodes,(const void*)g->nodes,n*sizeof(Node));
+	pthread_mutex_lock(&c->lock);
+	if(e->nodes!=NULL) c->evictions++;
+	free(e->nodes);
+	e->nodes = nodes;
+	e->node_count = n;
+	e->hash = hash;
+	e->fitness = g->fitness;
+	e->bad_flag = g->bad_flag;
+	pthread_mutex_unlock(&c->lock);
+	}
+
+/** sets the fitness of the genome if it is in the fitness cache of the config. returns 1 on success */
+static boolean_t GenomeCacheGet(GenomePtr g,uint64_t* hash)
+	{
+	ProgramPtr prog = GenomeCompile(g);
+	*hash = NodesHash(g->nodes,prog->node_count);
+	if(!FitnessCacheGet(g->config->fitness_cache,g,*hash,prog->node_count)) return 0;
+	if(!g->bad_flag && g->config->remove_introns)
+		{
+		g->node_count = prog->node_count;
+		}
+	return 1;
+	}
+
+static void GenomeCachePut(GenomePtr g,uint64_t hash)
+	{
+	FitnessCachePut(g->config->fitness_cache,g,hash,GenomeCompile(g)->node_count);
+	}
+
+/** GenomeEval using the fitness cache of the config, if any */
+static void GenomeEvalCached(GenomePtr g,SelectionPtr cutoff)
+	{
+	uint64_t hash;
+	if(g->config->fitness_cache==NULL)
+		{
+		GenomeEval(g,g->config->spreadsheet,cutoff);
+		return;
+		}
+	if(GenomeCacheGet(g,&hash)) return;
+	/* a genome rejected by the cutoff has no fitness */
+	if(GenomeEval(g,g->config->spreadsheet,cutoff))
+		{
+		GenomeCachePut(g,hash);
+		}
+	}
+
+
+size_t SpreadSheetColumns(const SpreadSheetPtr ptr)
+	{
+	return ptr->columns;
+	}
+
+size_t SpreadSheetRows(const SpreadSheetPtr ptr)
+	{
+	return ptr->size/SpreadSheetColumns(ptr);
+	}
+
+
+/**
+ * creates a SpreadSheet with 'n' rows of 'src' drawn at random, with a fixed
+ * seed. The normalized values of the last column are copied from 'src'.
+ */
+SpreadSheetPtr SpreadSheetSample(const SpreadSheetPtr src,size_t n)
+	{
+	size_t i,x,y=0UL;
+	unsigned int seed=1U;
+	const size_t nRows = SpreadSheetRows(src);
+	char* picked;
+	SpreadSheetPtr p;
+	if(n==0UL || n > nRows) THROW_ERROR("bad sample size");
+	picked=(char*)calloc(nRows,sizeof(char));
+	p=(SpreadSheetPtr)calloc(1,sizeof(SpreadSheet));
+	if(picked==NULL || p==NULL) THROW_ERROR("Out of memory");
+	/* Floyd's algorithm: n distinct rows */
+	for(i=nRows-n;i< nRows;++i)
+		{
+		size_t r = (size_t)(((double)rand_r(&seed)/((double)RAND_MAX+1.0))*(i+1));
+		if(picked[r]) r=i;
+		picked[r]=1;
+		}
+	p->columns = SpreadSheetColumns(src);
+	p->size = n*p->columns;
+	p->columnar = (floating_t*)calloc(p->size,sizeof(floating_t));
+	p->normalized = (floating_t*)calloc(n,sizeof(floating_t));
+	if(p->columnar==NULL || p->normalized==NULL) THROW_ERROR("Out of memory");
+	for(i=0;i< nRows;++i)
+		{
+		if(!picked[i]) continue;
+		for(x=0;x< p->columns;++x)
+			{
+			p->columnar[x*n+y] = SpreadSheetAt(src,i,x);
+			}
+		p->normalized[y] = src->normalized[i];
+		y++;
+		}
+	free(picked);
+	return p;
+	}
+
+void SpreadSheetFree(SpreadSheetPtr p)
+	{
+	if(p==NULL) return;
+	free(p->columnar);
+	free(p->normalized);
+	free(p);
+	}
+
+/**
+ * TSV loader. The input is mapped in memory, or read by large blocks when it
+ * is not a regular file. It is split in chunks at line boundaries and each
+ * chunk is parsed by its own thread, then the chunks are concatenated.
+ */
+enum	{
+	SHEET_OK=0,
+	SHEET_NOT_ENOUGH_COLUMNS,
+	SHEET_INCONSISTENT_COLUMNS,
+	SHEET_EXPECTED_TAB,
+	SHEET_BAD_FLOAT
+	};
+
+/* a chunk is parsed by its own thread only if the input is larger */
+#define SHEET_MIN_CHUNK_SIZE (1UL<<20)
+
+typedef struct sheet_input_t
+	{
+	char* base;
+	size_t size;
+	/* first byte to parse */
+	size_t offset;
+	/* base was mapped, else malloc'ed */
+	boolean_t mapped;
+	} SheetInput;
+
+/* destination of the cells when the TSV is converted to a cache, see SpreadSheetConvertCache */
+typedef struct sheet_cache_writer_t
+	{
+	/* cells (column-major) and normalized last column of the mapped cache, NULL during the first pass */
+	floating_t* cells;
+	floating_t* normalized;
+	size_t rows;
+	size_t columns;
+	/* extrema of the last column */
+	floating_t min_value;
+	floating_t max_value;
+	} SheetCacheWriter;
+
+typedef struct sheet_chunk_t
+	{
+	const char* begin;
+	const char* end;
+	/* cells, row-major */
+	floating_t* data;
+	size_t size;
+	size_t capacity;
+	size_t rows;
+	/* number of columns of the first row */
+	size_t columns;
+	/* first error of the chunk and its row in the chunk */
+	int error;
+	size_t error_row;
+	/* if not NULL, the cells are given to this writer instead of being stored in data */
+	SheetCacheWriter* writer;
+	/* first pass of the writer: extrema of each column of the chunk, 'capacity' is their size */
+	floating_t* minima;
+	floating_t* maxima;
+	/* second pass of the writer: index of the first row of the chunk */
+	size_t first_row;
+	pthread_t thread;
+	} SheetChunk;
+
+/* powers of 10 exactly representable as a double */
+static const double FLOAT_EXACT_POW10[23]={
+	1e0,1e1,1e2,1e3,1e4,1e5,1e6,1e7,1e8,1e9,1e10,1e11,
+	1e12,1e13,1e14,1e15,1e16,1e17,1e18,1e19,1e20,1e21,1e22
+	};
+
+static boolean_t FloatIsDelimiter(const char* p,const char* end)
+	{
+	return p==end || *p=='\t' || *p=='\n' || *p=='\r' || *p==' ';
+	}
+
+/**
+ * parses the float at 's'. returns the first character after the number or
+ * NULL if there is no number. Uses the exact fast path of Clinger when the
+ * decimal mantissa and the power of 10 are both exact doubles, else strtod.
+ * Doesn't depend on the locale for the fast path.
+ */
+static const char* FloatParse(const char* s,const char* end,floating_t* value)
+	{
+	const char* p=s;
+	boolean_t negative=0;
+	boolean_t any_digit=0;
+	boolean_t truncated=0;
+	uint64_t mantissa=0ULL;
+	int digits=0;
+	int exponent=0;
+	char tmp[128];
+	char* buf;
+	size_t n;
+	char* q;
+	if(p<end && (*p=='+' || *p=='-'))
+		{
+		negative=(*p=='-');
+		p++;
+		}
+	for(;p<end && *p>='0' && *p<='9';++p)
+		{
+		any_digit=1;
+		if(digits<19)
+			{
+			mantissa = mantissa*10ULL+(uint64_t)(*p-'0');
+			if(mantissa!=0ULL) digits++;
+			}
+		else
+			{
+			truncated=1;
+			}
+		}
+	if(p<end && *p=='.')
+		{
+		for(++p;p<end && *p>='0' && *p<='9';++p)
+			{
+			any_digit=1;
+			if(digits<19)
+				{
+				mantissa = mantissa*10ULL+(uint64_t)(*p-'0');
+				if(mantissa!=0ULL) digits++;
+				exponent--;
+				}
+			else
+				{
+				truncated=1;
+				}
+			}
+		}
+	if(!any_digit) goto slow;
+	if(p<end && (*p=='e' || *p=='E'))
+		{
+		int e=0;
+		boolean_t negative_exponent=0;
+		p++;
+		if(p<end && (*p=='+' || *p=='-'))
+			{
+			negative_exponent=(*p=='-');
+			p++;
+			}
+		if(!(p<end && *p>='0' && *p<='9')) goto slow;
+		for(;p<end && *p>='0' && *p<='9';++p)
+			{
+			if(e<100000) e = e*10+(*p-'0');
+			}
+		exponent += (negative_exponent?-e:e);
+		}
+	if(truncated || mantissa > (1ULL<<53) || exponent < -22 || exponent > 22 || !FloatIsDelimiter(p,end)) goto slow;
+	*value = (floating_t)mantissa;
+	if(exponent<0)
+		{
+		*value /= FLOAT_EXACT_POW10[-exponent];
+		}
+	else
+		{
+		*value *= FLOAT_EXACT_POW10[exponent];
+		}
+	if(negative) *value = -*value;
+	return p;
+	
+	slow:
+	/* strtod needs a NUL-terminated copy of the whole token, however long */
+	for(n=0;!FloatIsDelimiter(&s[n],end);++n) {}
+	buf = (n< sizeof(tmp)?tmp:(char*)malloc(n+1));
+	if(buf==NULL) THROW_ERROR("OUT OF MEMORY");
+	memcpy(buf,s,n);
+	buf[n]=0;
+	*value = strtod(buf,&q);
+	p = (q==buf?NULL:s+(q-buf));
+	if(buf!=tmp) free(buf);
+	return p;
+	}
+
+static void SheetChunkWrite(SheetChunk* c,size_t x,floating_t v)
+	{
+	SheetCacheWriter* w=c->writer;
+	if(w->cells==NULL)
+		{
+		if(x==c->capacity)
+			{
+			c->capacity++;
+			c->minima = (floating_t*)realloc(c->minima,c->capacity*sizeof(floating_t));
+			c->maxima = (floating_t*)realloc(c->maxima,c->capacity*sizeof(floating_t));
+			if(c->minima==NULL || c->maxima==NULL) THROW_ERROR("OUT OF MEMORY");
+			c->minima[x]=v;
+			c->maxima[x]=v;
+			}
+		if(v < c->minima[x]) c->minima[x]=v;
+		if(v > c->maxima[x]) c->maxima[x]=v;
+		}
+	else
+		{
+		const size_t y=c->first_row+c->rows;
+		w->cells[x*w->rows+y]=v;
+		if(x+1==w->columns) w->normalized[y]=(v-w->min_value)/(w->max_value-w->min_value);
+		}
+	c->size++;
+	}
+
+static void SheetChunkPush(SheetChunk* c,size_t x,floating_t v)
+	{
+	if(c->writer!=NULL)
+		{
+		SheetChunkWrite(c,x,v);
+		return;
+		}
+	if(c->size==c->capacity)
+		{
+		c->capacity = MAX(1024UL,2*c->capacity);
+		c->data = (floating_t*)realloc(c->data,c->capacity*sizeof(floating_t));
+		if(c->data==NULL) THROW_ERROR("OUT OF MEMORY");
+		}
+	c->data[c->size++]=v;
+	}
+
+/** parses the lines of the chunk, stops at the first error */
+static void* SheetChunkParse(void* arg)
+	{
+	SheetChunk* c=(SheetChunk*)arg;
+	const char* p=c->begin;
+	size_t curr_cols=0UL;
+	while(p< c->end)
+		{
+		floating_t v;
+		const char* q;
+		while(p< c->end && *p==' ') p++;
+		if(curr_cols==0UL && (p==c->end || *p=='\n'))
+			{
+			/* empty line */
+			if(p< c->end) p++;
+			continue;
+			}
+		q=FloatParse(p,c->end,&v);
+		if(q==NULL)
+			{
+			c->error=SHEET_BAD_FLOAT;
+			break;
+			}
+		SheetChunkPush(c,curr_cols,v);
+		curr_cols++;
+		p=q;
+		if(p==c->end || *p=='\n')
+			{
+			if(curr_cols<2)
+				{
+				c->error=SHEET_NOT_ENOUGH_COLUMNS;
+				break;
+				}
+			else if(c->rows==0UL)
+				{
+				c->columns=curr_cols;
+				}
+			else if(curr_cols!=c->columns)
+				{
+				c->error=SHEET_INCONSISTENT_COLUMNS;
+				break;
+				}
+			c->rows++;
+			curr_cols=0UL;
+			if(p< c->end) p++;
+			}
+		else if(*p=='\t')
+			{
+			p++;
+			}
+		else
+			{
+			c->error=SHEET_EXPECTED_TAB;
+			break;
+			}
+		}
+	c->error_row=c->rows;
+	return NULL;
+	}
+
+/** maps the input if it is a regular file, else reads it */
+static void SheetInputLoad(SheetInput* input,FILE* in)
+	{
+	int fd=fileno(in);
+	struct stat st;
+	off_t start;
+	size_t capacity=0UL;
+	memset((void*)input,0,sizeof(SheetInput));
+	if(fd!=-1 && fstat(fd,&st)==0 && S_ISREG(st.st_mode) &&
+		(start=lseek(fd,0,SEEK_CUR))>=0 && st.st_size>start)
+		{
+		void* m=mmap(NULL,(size_t)st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+		if(m!=MAP_FAILED)
+			{
+			madvise(m,(size_t)st.st_size,MADV_SEQUENTIAL);
+			input->base=(char*)m;
+			input->size=(size_t)st.st_size;
+			input->offset=(size_t)start;
+			input->mapped=1;
+			return;
+			}
+		}
+	for(;;)
+		{
+		size_t n;
+		if(input->size==capacity)
+			{
+			capacity = MAX(4UL<<20,2*capacity);
+			input->base=(char*)realloc(input->base,capacity);
+			if(input->base==NULL) THROW_ERROR("OUT OF MEMORY");
+			}
+		n=fread(&(input->base[input->size]),1,capacity-input->size,in);
+		if(n==0UL) break;
+		input->size+=n;
+		}
+	}
+
+static void SheetInputFree(SheetInput* input)
+	{
+	if(input->mapped)
+		{
+		munmap(input->base,input->size);
+		}
+	else
+		{
+		free(input->base);
+		}
+	}
+
+static void SpreadSheetNormalize(SpreadSheetPtr p);
+
+/** splits the TSV 'input' in at most 'num_threads' chunks */
+static SheetChunk* SheetInputSplit(const SheetInput* input,size_t num_threads,size_t* num_chunks)
+	{
+	size_t k;
+	SheetChunk* chunks;
+	const char* begin = &(input->base[input->offset]);
+	const char* end = &(input->base[input->size]);
+	*num_chunks = MIN(MAX(num_threads,1UL),1UL+(size_t)(end-begin)/SHEET_MIN_CHUNK_SIZE);
+	chunks = (SheetChunk*)calloc(*num_chunks,sizeof(SheetChunk));
+	if(chunks==NULL) THROW_ERROR("Out of memory");
+	/* chunks start after a new line */
+	for(k=0;k< *num_chunks;++k)
+		{
+		const char* b = begin+((size_t)(end-begin)*k)/(*num_chunks);
+		if(k>0)
+			{
+			b = (const char*)memchr(b-1,'\n',(size_t)(end-(b-1)));
+			b = (b==NULL?end:b+1);
+			if(b< chunks[k-1].begin) b=chunks[k-1].begin;
+			chunks[k-1].end = b;
+			}
+		chunks[k].begin = b;
+		chunks[k].end = end;
+		}
+	return chunks;
+	}
+
+/** parses the chunks, each by its own thread */
+static void SheetChunksParse(SheetChunk* chunks,size_t num_chunks)
+	{
+	size_t k;
+	for(k=1;k< num_chunks;++k)
+		{
+		if(pthread_create(&chunks[k].thread,NULL,SheetChunkParse,&chunks[k])!=0) THROW_ERROR("Cannot create thread");
+		}
+	SheetChunkParse(&chunks[0]);
+	for(k=1;k< num_chunks;++k)
+		{
+		pthread_join(chunks[k].thread,NULL);
+		}
+	}
+
+/** reports the first error of the parsed chunks and exits, else returns the number of rows and sets 'columns' */
+static size_t SheetChunksCheck(const SheetChunk* chunks,size_t num_chunks,size_t* columns)
+	{
+	size_t k,rows=0UL;
+	*columns=0UL;
+	/* errors are reported in the order of the file */
+	for(k=0;k< num_chunks;++k)
+		{
+		const SheetChunk* c=&chunks[k];
+		int error=c->error;
+		size_t row=rows+c->error_row;
+		if(c->rows>0UL && *columns==0UL)
+			{
+			*columns=c->columns;
+			}
+		else if(c->rows>0UL && c->columns!=*columns && !(error!=SHEET_OK && c->error_row==0UL))
+			{
+			error=SHEET_INCONSISTENT_COLUMNS;
+			row=rows;
+			}
+		switch(error)
+			{
+			case SHEET_OK: break;
+			case SHEET_NOT_ENOUGH_COLUMNS:
+				fprintf(stderr,"Not enough column line %d\n",(int)(1+row));
+				exit(EXIT_FAILURE);
+			case SHEET_INCONSISTENT_COLUMNS:
+				fprintf(stderr,"Inconsistent column number %d\n",(int)(1+row));
+				exit(EXIT_FAILURE);
+			case SHEET_EXPECTED_TAB:
+				fprintf(stderr,"Expected a tab line %d\n",(int)(1+row));
+				exit(EXIT_FAILURE);
+			default:
+				fprintf(stderr,"Bad float line %d\n",(int)(1+row));
+				exit(EXIT_FAILURE);
+			}
+		rows+=c->rows;
+		}
+	if(rows==0UL) THROW_ERROR("Empty rows");
+	return rows;
+	}
+
+/** parses the TSV 'input', the chunks are parsed by at most 'num_threads' threads */
+static SpreadSheetPtr SheetInputParse(const SheetInput* input,size_t num_threads)
+	{
+	size_t i=0UL;
+	size_t k,num_chunks;
+	/* cells, row-major */
+	floating_t* data;
+	SheetChunk* chunks;
+	SpreadSheetPtr p=(SpreadSheetPtr)calloc(1,sizeof(SpreadSheet));
+	if(p==NULL) THROW_ERROR("Out of memory");
+	
+	chunks = SheetInputSplit(input,num_threads,&num_chunks);
+	SheetChunksParse(chunks,num_chunks);
+	SheetChunksCheck(chunks,num_chunks,&(p->columns));
+	for(k=0;k< num_chunks;++k)
+		{
+		p->size+=chunks[k].size;
+		}
+	if(num_chunks==1UL)
+		{
+		data=chunks[0].data;
+		}
+	else
+		{
+		data=(floating_t*)malloc(MAX(p->size,1UL)*sizeof(floating_t));
+		if(data==NULL) THROW_ERROR("OUT OF MEMORY");
+		for(i=0,k=0;k< num_chunks;++k)
+			{
+			if(chunks[k].size>0UL) memcpy((void*)&(data[i]),(void*)chunks[k].data,chunks[k].size*sizeof(floating_t));
+			i+=chunks[k].size;
+			free(chunks[k].data);
+			}
+		}
+	free(chunks);
+	
+	/* the cells are stored column-major, as used by the evaluation of the genomes */
+	p->columnar=(floating_t*)calloc(p->size,sizeof(floating_t));
+	if(p->columnar==NULL) THROW_ERROR("OUT OF MEMORY");
+	for(i=0;i< SpreadSheetRows(p);++i)
+		{
+		size_t x;
+		for(x=0;x< SpreadSheetColumns(p);++x)
+			{
+			p->columnar[x*SpreadSheetRows(p)+i] = data[i*SpreadSheetColumns(p)+x];
+			}
+		}
+	free(data);
+	SpreadSheetNormalize(p);
+	return p;
+	}
+
+/** reads a TSV file, the chunks are parsed by at most 'num_threads' threads */
+SpreadSheetPtr SpreadSheetRead(FILE* in,size_t num_threads)
+	{
+	SheetInput input;
+	SpreadSheetPtr p;
+	SheetInputLoad(&input,in);
+	p = SheetInputParse(&input,num_threads);
+	SheetInputFree(&input);
+	return p;
+	}
+
+/** fills p->normalized: the last column scaled to [0,1] */
+static void SpreadSheetNormalize(SpreadSheetPtr p)
+	{
+	size_t i;
+	floating_t min_value = DBL_MAX;
+	floating_t max_value =-DBL_MAX;
+	p->normalized=calloc(SpreadSheetRows(p),sizeof(floating_t));
+	if(p->normalized==NULL) THROW_ERROR("OUT OF MEMORY");
+	for(i=0;i< SpreadSheetRows(p);++i)
+		{
+		floating_t v= SpreadSheetAt(p,i,SpreadSheetColumns(p)-1);
+		if(v < min_value) min_value=v;
+		if(v > max_value) max_value=v;
+		}
+	
+	if(max_value==min_value)
+		{
+		fprintf(stderr,"Min==Max\n");
+		exit(EXIT_FAILURE);
+		}
+	
+	for(i=0;i< SpreadSheetRows(p);++i)
+		{
+		floating_t v=SpreadSheetAt(p,i,SpreadSheetColumns(p)-1);
+		p->normalized[i] = (v-min_value)/(max_value-min_value);
+		}
+	}
+
+/**
+ * Spreadsheet shared by the processes of a host, see --shm. The segment holds
+ * a header, then the cells (column-major) and the normalized target.
+ * The first process creates the segment and fills it while holding an
+ * exclusive flock on it; the others wait for this lock and check that the
+ * segment was read from the same input (see SheetInputHash). A segment that
+ * is unlocked but not ready was left by a creator that died: it is removed and
+ * created again.
+ */
+#define SHARED_SHEET_MAGIC 0x47454E50524F4732ULL
+
+typedef struct shared_sheet_header_t
+	{
+	uint64_t magic;
+	uint64_t ready;
+	uint64_t rows;
+	uint64_t columns;
+	/* size and hash of the input, see SheetInputHash */
+	uint64_t input_size;
+	uint64_t input_hash;
+	} SharedSheetHeader;
+
+/* name of the segment created by this process, removed at exit */
+static char* shared_sheet_created=NULL;
+
+static void SharedSheetUnlink(void)
+	{
+	if(shared_sheet_created!=NULL) shm_unlink(shared_sheet_created);
+	}
+
+/* SIGINT and SIGTERM: removes the segment, then dies of the signal */
+static void SharedSheetSignal(int sig)
+	{
+	SharedSheetUnlink();
+	signal(sig,SIG_DFL);
+	raise(sig);
+	}
+
+static size_t SharedSheetBytes(size_t rows,size_t columns)
+	{
+	return sizeof(SharedSheetHeader)+(rows*columns+rows)*sizeof(floating_t);
+	}
+
+/** hash of the bytes of the input, 8 bytes at a time */
+static uint64_t SheetInputHash(const SheetInput* input)
+	{
+	size_t i;
+	uint64_t h=14695981039346656037ULL;
+	const size_t n = input->size-input->offset;
+	const char* p = &(input->base[input->offset]);
+	for(i=0;i+8<=n;i+=8)
+		{
+		uint64_t w;
+		memcpy(&w,&p[i],sizeof(uint64_t));
+		h = (h^w)*0x9E3779B97F4A7C15ULL;
+		h ^= h>>29;
+		}
+	for(;i< n;++i)
+		{
+		h = (h^(uint8_t)p[i])*1099511628211ULL;
+		}
+	return h;
+	}
+
+/** points the arrays of 'p' to the segment */
+static void SharedSheetAttach(SpreadSheetPtr p,SharedSheetHeader* h)
+	{
+	floating_t* cells = (floating_t*)&h[1];
+	p->columns = h->columns;
+	p->size = h->rows*h->columns;
+	p->columnar = cells;
+	p->normalized = &cells[p->size];
+	}
+
+/**
+ * returns the spreadsheet of the segment 'name', read from 'in' (by
+ * 'num_threads' threads) if the segment doesn't exist yet.
+ */
+SpreadSheetPtr SpreadSheetShared(const char* name,FILE* in,size_t num_threads)
+	{
+	int fd;
+	int tries;
+	struct stat st;
+	SharedSheetHeader* h=NULL;
+	SpreadSheetPtr p;
+	SheetInput input;
+	uint64_t input_size,input_hash;
+	
+	SheetInputLoad(&input,in);
+	input_size = input.size-input.offset;
+	input_hash = SheetInputHash(&input);
+	for(;;)
+		{
+		fd = shm_open(name,O_RDWR|O_CREAT|O_EXCL,0644);
+		if(fd!=-1) break;
+		if(errno!=EEXIST)
+			{
+			fprintf(stderr,"Cannot create %s %s\n",name,strerror(errno));
+			exit(EXIT_FAILURE);
+			}
+		fd = shm_open(name,O_RDONLY,0);
+		/* removed in the meantime */
+		if(fd==-1 && errno==ENOENT) continue;
+		if(fd==-1)
+			{
+			fprintf(stderr,"Cannot open %s %s\n",name,strerror(errno));
+			exit(EXIT_FAILURE);
+			}
+		/* the creator holds an exclusive lock until the segment is ready */
+		for(tries=0;tries< 100;++tries)
+			{
+			if(flock(fd,LOCK_SH)!=0) THROW_ERROR("flock failed");
+			if(fstat(fd,&st)!=0) THROW_ERROR("fstat failed");
+			if(st.st_size >= (off_t)sizeof(SharedSheetHeader))
+				{
+				h = (SharedSheetHeader*)mmap(NULL,(size_t)st.st_size,PROT_READ,MAP_SHARED,fd,0);
+				if(h==MAP_FAILED) THROW_ERROR("mmap failed");
+				if(__atomic_load_n(&h->ready,__ATOMIC_ACQUIRE)!=0ULL) break;
+				munmap((void*)h,(size_t)st.st_size);
+				}
+			h=NULL;
+			/* the creator may not have taken its lock yet */
+			flock(fd,LOCK_UN);
+			usleep(10000);
+			}
+		/* the mapping keeps the file open: close() alone would not release the lock */
+		flock(fd,LOCK_UN);
+		close(fd);
+		if(h!=NULL) break;
+		fprintf(stderr,"%s was left unfinished by a process that died: creating it again\n",name);
+		shm_unlink(name);
+		}
+	if(h!=NULL)
+		{
+		if(h->magic!=SHARED_SHEET_MAGIC ||
+			(size_t)st.st_size < SharedSheetBytes(h->rows,h->columns))
+			{
+			fprintf(stderr,"%s is not a genprog spreadsheet\n",name);
+			exit(EXIT_FAILURE);
+			}
+		if(h->input_size!=input_size || h->input_hash!=input_hash)
+			{
+			fprintf(stderr,"%s was read from another input. Remove it (/dev/shm%s) if it was left by a previous run.\n",name,name);
+			exit(EXIT_FAILURE);
+			}
+		SheetInputFree(&input);
+		p=(SpreadSheetPtr)calloc(1,sizeof(SpreadSheet));
+		if(p==NULL) THROW_ERROR("Out of memory");
+		SharedSheetAttach(p,h);
+		return p;
+		}
+	else
+		{
+		/* this process creates the segment */
+		size_t bytes;
+		SpreadSheetPtr src;
+		if(flock(fd,LOCK_EX)!=0) THROW_ERROR("flock failed");
+		shared_sheet_created=strdup(name);
+		if(shared_sheet_created==NULL) THROW_ERROR("Out of memory");
+		atexit(SharedSheetUnlink);
+		signal(SIGINT,SharedSheetSignal);
+		signal(SIGTERM,SharedSheetSignal);
+		src=SheetInputParse(&input,num_threads);
+		SheetInputFree(&input);
+		bytes = SharedSheetBytes(SpreadSheetRows(src),SpreadSheetColumns(src));
+		if(ftruncate(fd,(off_t)bytes)!=0)
+			{
+			fprintf(stderr,"Cannot resize %s %s\n",name,strerror(errno));
+			exit(EXIT_FAILURE);
+			}
+		h = (SharedSheetHeader*)mmap(NULL,bytes,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+		if(h==MAP_FAILED) THROW_ERROR("mmap failed");
+		h->magic = SHARED_SHEET_MAGIC;
+		h->rows = SpreadSheetRows(src);
+		h->columns = SpreadSheetColumns(src);
+		h->input_size = input_size;
+		h->input_hash = input_hash;
+		p = src;
+		memcpy((void*)&h[1],(void*)src->columnar,src->size*sizeof(floating_t));
+		memcpy((void*)&(((floating_t*)&h[1])[src->size]),(void*)src->normalized,SpreadSheetRows(src)*sizeof(floating_t));
+		free(src->columnar);
+		free(src->normalized);
+		SharedSheetAttach(p,h);
+		__atomic_store_n(&h->ready,1ULL,__ATOMIC_RELEASE);
+		/* the other processes can attach */
+		flock(fd,LOCK_UN);
+		close(fd);
+		return p;
+		}
+	}
+
+/**
+ * Binary dataset cache, see --write-cache and --read-cache. The file holds a
+ * SheetCacheHeader, the minimum and the maximum of each column, the cells
+ * (column-major) and the normalized target. It is mapped read-only: the
+ * SpreadSheet points into the mapping, and the processes reading the same
+ * cache share its pages.
+ */
+#define SHEET_CACHE_MAGIC "GPSHEET"
+#define SHEET_CACHE_VERSION 1U
+
+typedef struct sheet_cache_header_t
+	{
+	char magic[8];
+	uint32_t version;
+	/* sizeof(floating_t) */
+	uint16_t float_size;
+	/* 1 when written on a little-endian host */
+	uint16_t little_endian;
+	uint64_t rows;
+	uint64_t columns;
+	} SheetCacheHeader;
+
+static uint16_t SheetCacheLittleEndian(void)
+	{
+	const uint16_t one=1;
+	return *((const uint8_t*)&one)==1;
+	}
+
+static size_t SheetCacheBytes(size_t rows,size_t columns)
+	{
+	return sizeof(SheetCacheHeader)+(2*columns+rows*columns+rows)*sizeof(floating_t);
+	}
+
+/**
+ * converts the TSV 'in' to the cache 'filename' without building the spreadsheet: a first
+ * pass checks the rows and computes the extrema of the columns, a second pass writes each
+ * cell at its offset in the mapped cache. The cache is written in a temporary file renamed
+ * at the end.
+ */
+void SpreadSheetConvertCache(FILE* in,const char* filename,size_t num_threads)
+	{
+	size_t k,x,num_chunks,rows,columns,bytes;
+	SheetInput input;
+	SheetChunk* chunks;
+	SheetCacheWriter writer;
+	SheetCacheHeader* h;
+	floating_t* minima;
+	floating_t* maxima;
+	char* tmp = (char*)malloc(strlen(filename)+5);
+	int fd,err;
+	if(tmp==NULL) THROW_ERROR("Out of memory");
+	memset((void*)&writer,0,sizeof(SheetCacheWriter));
+	SheetInputLoad(&input,in);
+	chunks = SheetInputSplit(&input,num_threads,&num_chunks);
+	for(k=0;k< num_chunks;++k)
+		{
+		chunks[k].writer=&writer;
+		}
+	SheetChunksParse(chunks,num_chunks);
+	rows = SheetChunksCheck(chunks,num_chunks,&columns);
+	
+	sprintf(tmp,"%s.tmp",filename);
+	fd = open(tmp,O_RDWR|O_CREAT|O_TRUNC,0644);
+	if(fd==-1)
+		{
+		fprintf(stderr,"Cannot open %s %s\n",tmp,strerror(errno));
+		exit(EXIT_FAILURE);
+		}
+	/* the blocks are allocated now, a full disk would be a SIGBUS when writing the mapping */
+	bytes = SheetCacheBytes(rows,columns);
+	if((err=posix_fallocate(fd,0,(off_t)bytes))!=0)
+		{
+		fprintf(stderr,"Cannot write %s %s\n",filename,strerror(err));
+		unlink(tmp);
+		exit(EXIT_FAILURE);
+		}
+	h = (SheetCacheHeader*)mmap(NULL,bytes,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+	if(h==MAP_FAILED) THROW_ERROR("mmap failed");
+	memcpy(h->magic,SHEET_CACHE_MAGIC,sizeof(SHEET_CACHE_MAGIC));
+	h->version = SHEET_CACHE_VERSION;
+	h->float_size = sizeof(floating_t);
+	h->little_endian = SheetCacheLittleEndian();
+	h->rows = rows;
+	h->columns = columns;
+	minima = (floating_t*)&h[1];
+	maxima = &minima[columns];
+	for(x=0;x< columns;++x)
+		{
+		minima[x] = DBL_MAX;
+		maxima[x] = -DBL_MAX;
+		for(k=0;k< num_chunks;++k)
+			{
+			if(chunks[k].rows==0UL) continue;
+			if(chunks[k].minima[x] < minima[x]) minima[x]=chunks[k].minima[x];
+			if(chunks[k].maxima[x] > maxima[x]) maxima[x]=chunks[k].maxima[x];
+			}
+		}
+	if(maxima[columns-1]==minima[columns-1])
+		{
+		fprintf(stderr,"Min==Max\n");
+		unlink(tmp);
+		exit(EXIT_FAILURE);
+		}
+	
+	/* second pass, the chunks write disjoint rows */
+	writer.cells = &maxima[columns];
+	writer.normalized = &(writer.cells[rows*columns]);
+	writer.rows = rows;
+	writer.columns = columns;
+	writer.min_value = minima[columns-1];
+	writer.max_value = maxima[columns-1];
+	for(k=0;k< num_chunks;++k)
+		{
+		chunks[k].first_row = (k==0?0UL:chunks[k-1].first_row+chunks[k-1].rows);
+		}
+	for(k=0;k< num_chunks;++k)
+		{
+		chunks[k].rows = 0UL;
+		chunks[k].size = 0UL;
+		}
+	SheetChunksParse(chunks,num_chunks);
+	
+	if(munmap((void*)h,bytes)!=0 ||
+		close(fd)!=0 ||
+		rename(tmp,filename)!=0)
+		{
+		fprintf(stderr,"Cannot write %s %s\n",filename,strerror(errno));
+		unlink(tmp);
+		exit(EXIT_FAILURE);
+		}
+	for(k=0;k< num_chunks;++k)
+		{
+		free(chunks[k].minima);
+		free(chunks[k].maxima);
+		}
+	free(chunks);
+	SheetInputFree(&input);
+	free(tmp);
+	}
+
+/** maps the cache 'filename', written by SpreadSheetConvertCache */
+SpreadSheetPtr SpreadSheetMapCache(const char* filename)
+	{
+	struct stat st;
+	SheetCacheHeader* h;
+	const floating_t* maxima;
+	const floating_t* minima;
+	floating_t* cells;
+	SpreadSheetPtr p;
+	int fd = open(filename,O_RDONLY);
+	if(fd==-1 || fstat(fd,&st)!=0)
+		{
+		fprintf(stderr,"Cannot open %s %s\n",filename,strerror(errno));
+		exit(EXIT_FAILURE);
+		}
+	if((size_t)st.st_size < sizeof(SheetCacheHeader))
+		{
+		fprintf(stderr,"%s is not a genprog cache\n",filename);
+		exit(EXIT_FAILURE);
+		}
+	h = (SheetCacheHeader*)mmap(NULL,(size_t)st.st_size,PROT_READ,MAP_SHARED,fd,0);
+	close(fd);
+	if(h==MAP_FAILED) THROW_ERROR("mmap failed");
+	if(memcmp(h->magic,SHEET_CACHE_MAGIC,sizeof(SHEET_CACHE_MAGIC))!=0 ||
+		h->version!=SHEET_CACHE_VERSION ||
+		h->float_size!=sizeof(floating_t) ||
+		h->little_endian!=SheetCacheLittleEndian() ||
+		h->columns<2 || h->rows==0 ||
+		(size_t)st.st_size!=SheetCacheBytes(h->rows,h->columns))
+		{
+		fprintf(stderr,"%s is not a genprog cache of this version or of this architecture\n",filename);
+		exit(EXIT_FAILURE);
+		}
+	minima = (const floating_t*)&h[1];
+	maxima = &minima[h->columns];
+	cells = (floating_t*)&maxima[h->columns];
+	if(maxima[h->columns-1]==minima[h->columns-1])
+		{
+		fprintf(stderr,"Min==Max\n");
+		exit(EXIT_FAILURE);
+		}
+	p=(SpreadSheetPtr)calloc(1,sizeof(SpreadSheet));
+	if(p==NULL) THROW_ERROR("Out of memory");
+	p->columns = h->columns;
+	p->size = h->rows*h->columns;
+	p->columnar = cells;
+	p->normalized = &cells[p->size];
+	p->mapped = 1;
+	return p;
+	}
+
+/**
+ * gives 'advice' (see madvise) on the rows [begin,end) of a mapped spreadsheet.
+ * MADV_DONTNEED only drops the pages lying entirely in the range: a page
+ * shared with other rows is kept.
+ */
+static void SpreadSheetAdvise(const SpreadSheetPtr p,size_t begin,size_t end,int advice)
+	{
+	size_t x;
+	const uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+	if(!p->mapped || begin>=end) return;
+	for(x=0;x<= SpreadSheetColumns(p);++x)
+		{
+		/* the columns, then the normalized target */
+		const floating_t* column = (x< SpreadSheetColumns(p)?SpreadSheetColumn(p,x):p->normalized);
+		uintptr_t from = ((uintptr_t)&column[begin]) & ~(page-1);
+		uintptr_t to = (uintptr_t)&column[end];
+		if(advice==MADV_DONTNEED)
+			{
+			/* the pages at both ends may hold the next rows, or the last rows of the previous column */
+			from = (((uintptr_t)&column[begin])+page-1) & ~(page-1);
+			to &= ~(page-1);
+			if(to<=from) continue;
+			}
+		madvise((void*)from,(size_t)(to-from),advice);
+		}
+	}
+
+/**
+ * mutations for --subtree-operators, the genome stays a complete tree:
+ * either a subtree is replaced by a new random one, or a node is replaced
+ * by a node of the same kind (an operator by an operator with the same number
+ * of children).
+ */
+static void GenomeMuteSubtree(GenomePtr g)
+	{
+	ConfigPtr cfg=g->config;
+	size_t* sizes=NULL;
+	
+	while(  GenomeSize(g) >0 &&
+		RANDOM_FLOAT(cfg) < cfg->probability_mutation)
+		{
+		size_t i;
+		GenomeUncompile(g);
+		sizes=(size_t*)realloc(sizes,2*GenomeSize(g)*sizeof(size_t));
+		if(sizes==NULL) THROW_ERROR("boum");
+		GenomeSubtreeSizes(g,sizes,&sizes[GenomeSize(g)]);
+		if(sizes[0]==NPOS) THROW_ERROR("not a tree");
+		/* trailing introns */
+		g->node_count = sizes[0];
+		i= RANDOM_SIZE_T(cfg,g->node_count);
+		
+		if( RANDOM_FLOAT(cfg) < 0.3 )
+			{
+			/* new subtree */
+			size_t tail = GenomeSize(g) - (i+sizes[i]);
+			size_t others = GenomeSize(g)-sizes[i];
+			size_t max_size = (others < (size_t)cfg->max_base_per_genome ? (size_t)cfg->max_base_per_genome - others : 1UL);
+			NodePtr nodes=GenomeNodesAlloc(g,i+max_size+tail);
+			size_t new_size;
+			memcpy((void*)nodes,(void*)g->nodes,i*sizeof(Node));
+			new_size = NodesGrow(cfg,&nodes[i],1UL,max_size);
+			memcpy((void*)&nodes[i+new_size],(void*)&g->nodes[i+sizes[i]],tail*sizeof(Node));
+			if(g->arena==NULL) free(g->nodes);
+			g->nodes = nodes;
+			g->node_count = i+new_size+tail;
+			}
+		else
+			{
+			NodePtr node=&(g->nodes[i]);
+			switch(NodeType(node))
+				{
+				case CONSTANT: NodeInitConstant(cfg,node);break;
+				/* NodeInitOperator creates a column and NodeInitColumn an operator */
+				case COLUMN: NodeInitOperator(cfg,node);break;
+				case OPERATOR:
+					{
+					Node other;
+					NodeInitColumn(cfg,&other);
+					if(NodeArity(cfg,&other)==NodeArity(cfg,node))
+						{
+						*node = other;
+						}
+					break;
+					}
+				default: THROW_ERROR("BOUM");
+				}
+			}
+		}
+	free(sizes);
+	}
+
+void GenomeMute(GenomePtr g)
+	{
+	size_t i;
+	ConfigPtr cfg=g->config;
+	
+	if(cfg->subtree_operators)
+		{
+		GenomeMuteSubtree(g);
+		return;
+		}
+	
+	while(  GenomeSize(g) >0 &&
+		RANDOM_FLOAT(cfg) < cfg->probability_mutation)
+		{
+		GenomeUncompile(g);
+		i= RANDOM_SIZE_T(cfg,g->node_count);
+		
+		float rnd= RANDOM_FLOAT(cfg);
+		if( rnd < 0.05 )
+			{
+			//insert
+			size_t j,insert_size= 1 + RANDOM_SIZE_T( cfg , 5); 
+			GenomeNodesResize(g, g->node_count + insert_size);
+			memmove(
+				(void*)&g->nodes[i+insert_size],//dest
+				(void*)&g->nodes[i],//src
+				(GenomeSize(g) - i)*sizeof(Node)
+				);
+			for(j=0;j< insert_size;++j)
+				{
+				NodeInit(cfg,&(g->nodes[i+j]));
+				}
+			g->node_count+=insert_size;
+			}
+		else if(rnd< 0.1)
+			{
+			//delete
+			size_t del_size= 1 + RANDOM_SIZE_T( cfg , 5); 
+			if( i+del_size > GenomeSize(g))
+				{
+				del_size = GenomeSize(g) - i;
+				}
+				
+			memmove(
+				(void*)&g->nodes[i],//dest
+				(void*)&g->nodes[i+del_size],//src
+				(GenomeSize(g) - (i+del_size))*sizeof(Node)
+				);
+				
+			g->node_count -= del_size;
+				
+			}
+		else if(rnd < 0.2)
+			{
+			//silent mutation
+			size_t insert_size=2; 
+			GenomeNodesResize(g, g->node_count + insert_size);
+			
+			
+			memmove(
+				(void*)&g->nodes[i+1+insert_size],//dest
+				(void*)&g->nodes[i+1],//src
+				(GenomeSize(g) - (i+1))*sizeof(Node)
+				);
+			memcpy(
+				(void*)&g->nodes[i+1],//dest
+				(void*)&g->nodes[i],//src
+				sizeof(Node)
+				);
+			memcpy(
+				(void*)&g->nodes[i+2],//dest
+				(void*)&g->nodes[i],//src
+				sizeof(Node)
+				);
+			g->node_count+=insert_size;
+			
+			switch(  RANDOM_SIZE_T( cfg , 4) )
+				{
+				case 0: {
+					NodeSetOperator(&g->nodes[i], cfg->operators->plus->index);
+					
+					NodeSetConstant(&g->nodes[i+2], 0.0);
+					break;
+					};
+				case 1: {
+					NodeSetOperator(&g->nodes[i], cfg->operators->minus->index);
+					
+					NodeSetConstant(&g->nodes[i+2], 0.0);
+					break;
+					};
+				case 2: {
+					NodeSetOperator(&g->nodes[i], cfg->operators->mul->index);
+					
+					NodeSetConstant(&g->nodes[i+2], 1.0);
+					break;
+					};
+				default:
+					{
+					
+					NodeSetOperator(&g->nodes[i], cfg->operators->mul->index);
+					
+					NodeSetConstant(&g->nodes[i+2], 1.0);
+					
+					break;
+					}
+				}
+			}
+		else if( rnd < 0.3)
+			{
+			NodeInit(cfg,&(g->nodes[i]));
+			}
+		else
+			{
+			NodeMut(cfg,&(g->nodes[i]));
+			}
+		}
+	}
+
+/**
+ * crossover for --subtree-operators: a random subtree of p1 is replaced by a
+ * random subtree of p2. Both parents must be complete trees; the child is a
+ * complete tree of at most max_base_per_genome nodes.
+ */
+static GenomePtr GenomeXCrossSubtree(
+	ConfigPtr cfg,
+	GenomePtr p1,
+	GenomePtr p2
+	)
+	{
+	GenomePtr g = GenomeNew1(cfg);
+	size_t n1=GenomeSize(p1),n2=GenomeSize(p2);
+	size_t* sizes1=(size_t*)malloc(2*n1*sizeof(size_t));
+	size_t* sizes2=(size_t*)malloc(2*n2*sizeof(size_t));
+	size_t xcross1=0UL,xcross2=0UL,tail,tries;
+	if(sizes1==NULL || sizes2==NULL) THROW_ERROR("boum");
+	GenomeSubtreeSizes(p1,sizes1,&sizes1[n1]);
+	GenomeSubtreeSizes(p2,sizes2,&sizes2[n2]);
+	if(sizes1[0]==NPOS || sizes2[0]==NPOS) THROW_ERROR("not a tree");
+	/* ignore the trailing introns */
+	n1=sizes1[0];
+	n2=sizes2[0];
+	
+	for(tries=0;tries<10;++tries)
+		{
+		xcross1 = RANDOM_SIZE_T(cfg,n1);
+		xcross2 = RANDOM_SIZE_T(cfg,n2);
+		if(n1 - sizes1[xcross1] + sizes2[xcross2] <= (size_t)cfg->max_base_per_genome) break;
+		}
+	if(tries==10)
+		{
+		/* no room: the child is a copy of p1 */
+		xcross1 = n1;
+		xcross2 = 0UL;
+		tail = 0UL;
+		g->node_count = n1;
+		}
+	else
+		{
+		tail = n1-(xcross1+sizes1[xcross1]);
+		g->node_count = xcross1 + sizes2[xcross2] + tail;
+		}
+	
+	g->nodes = GenomeNodesAlloc(g,g->node_count);
+	memcpy((void*)g->nodes,(void*)p1->nodes,xcross1*sizeof(Node));
+	if(xcross1 < n1)
+		{
+		memcpy((void*)&g->nodes[xcross1],(void*)&(p2->nodes[xcross2]),sizes2[xcross2]*sizeof(Node));
+		memcpy((void*)&g->nodes[xcross1+sizes2[xcross2]],(void*)&(p1->nodes[n1-tail]),tail*sizeof(Node));
+		}
+	free(sizes1);
+	free(sizes2);
+	
+	GenomeMute(g);
+	return g;
+	}
+
+static GenomePtr GenomeXCross(
+	ConfigPtr cfg,
+	GenomePtr p1,
+	GenomePtr p2
+	)
+	{
+	GenomePtr g = GenomeNew1(cfg);
+	size_t xcross1;
+	size_t xcross2;
+	
+	if(cfg->subtree_operators)
+		{
+		GenomeFree(g);
+		return GenomeXCrossSubtree(cfg,p1,p2);
+		}
+	
+	if(RANDOM_FLOAT(cfg)<0.1)
+		{
+		xcross1 = RANDOM_SIZE_T(cfg,GenomeSize(p1));
+		xcross2 = RANDOM_SIZE_T(cfg,GenomeSize(p2));
+		}
+	else
+		{
+		xcross1 = RANDOM_SIZE_T(cfg, MIN( GenomeSize(p1), GenomeSize(p2) ));
+		xcross2 = xcross1;
+		}
+	
+	
+	g->node_count=  xcross1 + (GenomeSize(p2)-xcross2);
+	
+	
+	g->nodes = GenomeNodesAlloc(g,g->node_count);
+	memcpy((void*)g->nodes,(void*)p1->nodes,xcross1*sizeof(Node));
+	memcpy((void*)&g->nodes[xcross1],(void*)&(p2->nodes[xcross2]),(GenomeSize(p2)-xcross2)*sizeof(Node));
+	
+	GenomeMute(g);
+	return g;
+	}
+
+
+static void GenomeToDot(const GenomePtr g,size_t* parent_index,size_t* nodeIndex,FILE* out)
+	{
+	size_t save_index=(*nodeIndex);
+	NodePtr node;
+	if(*nodeIndex>=GenomeSize(g)) return;
+	node = GenomeAt(g, *nodeIndex );
+	fprintf(out,"n%d[label=",*nodeIndex);
+	switch(NodeType(node))
+		{
+		case CONSTANT:
+			{
+			fprintf(out,"\"%f\"];\n", NodeConstant(node));
+			break;
+			}
+		case COLUMN:
+			{
+			fprintf(out,"\"${%d}\"];\n", NodeColumn(node) + 1);
+			break;
+			}
+		case OPERATOR:
+			{
+			
+			size_t i;
+			OperatorPtr op = OperatorListAt(g->config->operators, NodeOperator(node));
+			fprintf(out,"\"%s\"];\n", op->name);
+			
+			for(i=0;i< op->num_children;++i)
+				{
+				*nodeIndex=*nodeIndex + 1;
+				GenomeToDot(g,&save_index,nodeIndex,out);
+				}
+			break;
+			}
+		default:break;
+		}
+
+	if(parent_index!=NULL)
+		{
+		fprintf(out,"n%d -> n%d ;\n",save_index,*parent_index);
+		}
+	}
+
+/* the files are written in a temporary file, renamed by SAFE_FCLOSE: a reader never sees a partial file */
+#define SAFE_FOPEN(ext) strcpy(fname,g->config->output_filename); \
+	strcat(fname,ext);\
+	strcpy(tmpname,fname);\
+	strcat(tmpname,".tmp");\
+	out=fopen(tmpname,"w");\
+	if(out==NULL) { fprintf(stderr,"Cannot open \"%s\". (%s)\n",tmpname,strerror(errno)); exit(EXIT_FAILURE);}
+
+#define SAFE_FCLOSE() if(fclose(out)!=0 || rename(tmpname,fname)!=0) { fprintf(stderr,"Cannot write \"%s\". (%s)\n",fname,strerror(errno)); exit(EXIT_FAILURE);}
+	
+void GenomeSave(const GenomePtr g)
+	{
+	size_t index=0UL,rowIndex;
+	FILE* out=NULL;
+	char* fname=NULL;
+	char* tmpname=NULL;
+	floating_t* values=NULL;
+	if(g->config->output_filename==NULL) return;
+	fname=(char*)calloc(strlen(g->config->output_filename)+20,sizeof(char));
+	tmpname=(char*)calloc(strlen(g->config->output_filename)+24,sizeof(char));
+	if(fname==NULL || tmpname==NULL) THROW_ERROR("Out of memory");
+	SAFE_FOPEN(".dot");
+	fputs("digraph {\n",out);
+	GenomeToDot(g,NULL,&index,out);
+	fputs("}\n",out);
+	SAFE_FCLOSE();
+	
+	SAFE_FOPEN(".tsv");
+	values = GenomeEvalStack(g);
+	for(rowIndex=0;
+		rowIndex< SpreadSheetRows(g->config->spreadsheet);
+		rowIndex+=EVAL_BLOCK_SIZE)
+		{
+		size_t k;
+		size_t n = MIN(EVAL_BLOCK_SIZE, SpreadSheetRows(g->config->spreadsheet)-rowIndex);
+		GenomeEvalRows(g,g->config->spreadsheet,rowIndex,n,values);
+		for(k=0;k< n;++k)
+			{
+			size_t i;
+			for(i=0;i< SpreadSheetColumns(g->config->spreadsheet);++i)
+				{
+				fprintf(out,"%E\t",SpreadSheetAt(g->config->spreadsheet,rowIndex+k,i));
+				}
+			if(isnan(values[k]))
+				{
+				fputs("NA",out);
+				}
+			else
+				{
+				fprintf(out,"%E",values[k]);
+				}
+			fputs("\n",out);
+			}
+		}
+	SAFE_FCLOSE();
+
+	SAFE_FOPEN(".R");
+	fprintf(out,"T<-read.table(\"%s.tsv\",header=F,sep=\"\t\")\n",g->config->output_filename);
+	fputs("T<-T[order(T[,ncol(T)-1]),]\n",out);
+	fprintf(out,"jpeg(\"%s.plot1.jpeg\")\n",g->config->output_filename);
+	fputs("plot(T[,ncol(T)-1],col=\"red\")\n",out);
+	fputs("points(T[,ncol(T)],col=\"green\")\n",out);
+	fputs("dev.off()\n",out);
+	SAFE_FCLOSE();
+	
+	SAFE_FOPEN(".mk");
+	fprintf(out,".PHONY=all\nOUTPUT=%s\n",g->config->output_filename);
+	fprintf(out,"all:${OUTPUT}.png ${OUTPUT}.plot1.jpeg\n");
+	fprintf(out,"${OUTPUT}.png: ${OUTPUT}.dot\n\tdot -Tpng -o$@ $<\n");
+	fprintf(out,"${OUTPUT}.plot1.jpeg: ${OUTPUT}.R ${OUTPUT}.tsv\n\tR --no-save < $<\n");
+	SAFE_FCLOSE();
+
+	free(fname);
+	free(tmpname);
+	}
+
+/**
+ * Checkpoint of a population, see --checkpoint and --resume. The file holds a
+ * CheckpointHeader, then one CheckpointGenome followed by its nodes for the
+ * best genome (if any) and for each genome of the generation. The header keeps
+ * the options changing the trajectory: a checkpoint is only resumed with the
+ * same options and the same dataset.
+ */
+#define CHECKPOINT_MAGIC "GPCHKPT"
+#define CHECKPOINT_VERSION 1U
+
+/* options changing the trajectory of the evolution */
+typedef struct checkpoint_settings_t
+	{
+	uint64_t rows;
+	uint64_t columns;
+	uint64_t operators;
+	int64_t min_genomes_per_generation;
+	int64_t max_genomes_per_generation;
+	int64_t min_base_per_genome;
+	int64_t max_base_per_genome;
+	int64_t weight_constant;
+	int64_t weight_op;
+	int64_t weight_column;
+	double max_fraction_of_errors;
+	double probability_mutation;
+	int64_t massive_extinction_every;
+	double massive_extinction_if_fitness_gt;
+	/* the boolean options, one bit each */
+	uint64_t flags;
+	uint64_t offspring_count;
+	uint64_t tournament_size;
+	uint64_t sample_rows;
+	double sample_promotion;
+	} CheckpointSettings;
+
+typedef struct checkpoint_header_t
+	{
+	char magic[8];
+	uint32_t version;
+	/* sizeof(floating_t) */
+	uint16_t float_size;
+	/* 1 when written on a little-endian host */
+	uint16_t little_endian;
+	/* config->curr_generations */
+	int64_t generation;
+	/* number of genomes of the generation */
+	uint64_t genome_count;
+	/* 1 if the first genome of the file is the best one */
+	uint64_t has_best;
+	/* config->random */
+	uint64_t random[4];
+	uint64_t random_kind;
+	CheckpointSettings settings;
+	} CheckpointHeader;
+
+typedef struct checkpoint_genome_t
+	{
+	floating_t fitness;
+	int64_t generation;
+	int64_t creation;
+	uint64_t node_count;
+	uint32_t bad_flag;
+	uint32_t reserved;
+	} CheckpointGenome;
+
+static void CheckpointSettingsInit(ConfigPtr config,CheckpointSettings* s)
+	{
+	const boolean_t flags[]={
+		config->remove_introns,
+		config->best_will_survive,
+		config->enable_self_self,
+		config->normalize_data,
+		config->sort_on_genome_size,
+		config->remove_clone,
+		config->simplify,
+		config->subtree_operators,
+		config->steady_state,
+		/* rand_r without thread keeps its sequential sequence, see Evolve */
+		config->random.kind==RANDOM_RAND_R && config->num_threads==1
+		};
+	size_t i;
+	memset((void*)s,0,sizeof(CheckpointSettings));
+	s->rows = SpreadSheetRows(config->spreadsheet);
+	s->columns = SpreadSheetColumns(config->spreadsheet);
+	s->operators = OperatorListSize(config->operators);
+	s->min_genomes_per_generation = config->min_genomes_per_generation;
+	s->max_genomes_per_generation = config->max_genomes_per_generation;
+	s->min_base_per_genome = config->min_base_per_genome;
+	s->max_base_per_genome = config->max_base_per_genome;
+	s->weight_constant = config->weight_constant;
+	s->weight_op = config->weight_op;
+	s->weight_column = config->weight_column;
+	s->max_fraction_of_errors = config->max_fraction_of_errors;
+	s->probability_mutation = config->probability_mutation;
+	s->massive_extinction_every = config->massive_extinction_every;
+	s->massive_extinction_if_fitness_gt = config->massive_extinction_if_fitness_gt;
+	for(i=0;i< sizeof(flags)/sizeof(flags[0]);++i)
+		{
+		if(flags[i]) s->flags |= (1UL<<i);
+		}
+	s->offspring_count = config->offspring_count;
+	s->tournament_size = config->tournament_size;
+	s->sample_rows = (config->sample==NULL?0UL:config->sample_rows);
+	s->sample_promotion = config->sample_promotion;
+	}
+
+static size_t CheckpointGenomeBytes(const GenomePtr g)
+	{
+	return sizeof(CheckpointGenome)+g->node_count*sizeof(Node);
+	}
+
+static char* CheckpointGenomeWrite(const GenomePtr g,char* p)
+	{
+	CheckpointGenome r;
+	memset((void*)&r,0,sizeof(CheckpointGenome));
+	r.fitness = g->fitness;
+	r.generation = g->generation;
+	r.creation = (int64_t)g->creation;
+	r.node_count = g->node_count;
+	r.bad_flag = (g->bad_flag?1U:0U);
+	memcpy(p,&r,sizeof(CheckpointGenome));
+	p+=sizeof(CheckpointGenome);
+	memcpy(p,g->nodes,g->node_count*sizeof(Node));
+	return p+g->node_count*sizeof(Node);
+	}
+
+/** returns a copy of the population in the checkpoint format, see CheckpointWriteFile */
+static void* CheckpointSerialize(ConfigPtr config,const GenerationPtr gen,const GenomePtr best,size_t* length)
+	{
+	size_t i;
+	char* buf;
+	char* p;
+	CheckpointHeader h;
+	*length = sizeof(CheckpointHeader);
+	if(best!=NULL) *length += CheckpointGenomeBytes(best);
+	for(i=0;i< GenerationCount(gen);++i) *length += CheckpointGenomeBytes(GenerationAt(gen,i));
+	buf=(char*)malloc(*length);
+	if(buf==NULL) THROW_ERROR("boum");
+	memset((void*)&h,0,sizeof(CheckpointHeader));
+	memcpy(h.magic,CHECKPOINT_MAGIC,sizeof(CHECKPOINT_MAGIC));
+	h.version = CHECKPOINT_VERSION;
+	h.float_size = sizeof(floating_t);
+	h.little_endian = SheetCacheLittleEndian();
+	h.generation = config->curr_generations;
+	h.genome_count = GenerationCount(gen);
+	h.has_best = (best!=NULL);
+	memcpy(h.random,config->random.s,sizeof(h.random));
+	h.random_kind = config->random.kind;
+	CheckpointSettingsInit(config,&h.settings);
+	memcpy(buf,&h,sizeof(CheckpointHeader));
+	p = &buf[sizeof(CheckpointHeader)];
+	if(best!=NULL) p = CheckpointGenomeWrite(best,p);
+	for(i=0;i< GenerationCount(gen);++i) p = CheckpointGenomeWrite(GenerationAt(gen,i),p);
+	return buf;
+	}
+
+/** writes 'buf' in 'filename': temporary file, fsync, rename, then fsync of the directory */
+static void CheckpointWriteFile(const char* filename,const void* buf,size_t length)
+	{
+	char* tmp = (char*)malloc(strlen(filename)+5);
+	char* dir = strdup(filename);
+	char* slash;
+	FILE* out;
+	int fd;
+	if(tmp==NULL || dir==NULL) THROW_ERROR("Out of memory");
+	sprintf(tmp,"%s.tmp",filename);
+	out = fopen(tmp,"wb");
+	if(out==NULL)
+		{
+		fprintf(stderr,"Cannot open %s %s\n",tmp,strerror(errno));
+		exit(EXIT_FAILURE);
+		}
+	if(fwrite(buf,1,length,out)!=length ||
+		fflush(out)!=0 ||
+		fsync(fileno(out))!=0 ||
+		fclose(out)!=0 ||
+		rename(tmp,filename)!=0)
+		{
+		fprintf(stderr,"Cannot write %s %s\n",filename,strerror(errno));
+		unlink(tmp);
+		exit(EXIT_FAILURE);
+		}
+	/* the rename itself must reach the disk */
+	slash = strrchr(dir,'/');
+	if(slash==NULL) strcpy(dir,".");
+	else if(slash==dir) slash[1]=0;
+	else slash[0]=0;
+	fd = open(dir,O_RDONLY);
+	if(fd!=-1)
+		{
+		fsync(fd);
+		close(fd);
+		}
+	free(dir);
+	free(tmp);
+	}
+
+/** reads a genome of a checkpoint. returns NULL if it is not valid for 'config' */
+static GenomePtr CheckpointGenomeRead(ConfigPtr config,const char** p,const char* end)
+	{
+	CheckpointGenome r;
+	GenomePtr g;
+	if((size_t)(end-*p) < sizeof(CheckpointGenome)) return NULL;
+	memcpy(&r,*p,sizeof(CheckpointGenome));
+	*p += sizeof(CheckpointGenome);
+	if(r.node_count==0UL || r.node_count > (size_t)(end-*p)/sizeof(Node)) return NULL;
+	g = GenomeNew1(config);
+	g->node_count = r.node_count;
+	g->nodes = GenomeNodesAlloc(g,g->node_count);
+	memcpy((void*)g->nodes,*p,g->node_count*sizeof(Node));
+	*p += g->node_count*sizeof(Node);
+	g->fitness = r.fitness;
+	g->generation = r.generation;
+	g->creation = (time_t)r.creation;
+	g->bad_flag = (r.bad_flag!=0U);
+	if(!GenomeNodesValid(config,g))
+		{
+		GenomeFree(g);
+		return NULL;
+		}
+	return g;
+	}
+
+/**
+ * restores the checkpoint 'filename': config->curr_generations, config->random
+ * and the best genome. returns the generation, its genomes are in 'arena'
+ */
+static GenerationPtr CheckpointRestore(ConfigPtr config,const char* filename,ArenaPtr arena,GenomePtr* best)
+	{
+	struct stat st;
+	size_t i;
+	const CheckpointHeader* h;
+	CheckpointSettings settings;
+	const char* p;
+	const char* end;
+	GenerationPtr gen;
+	int fd = open(filename,O_RDONLY);
+	if(fd==-1 || fstat(fd,&st)!=0)
+		{
+		fprintf(stderr,"Cannot open %s %s\n",filename,strerror(errno));
+		exit(EXIT_FAILURE);
+		}
+	if((size_t)st.st_size < sizeof(CheckpointHeader))
+		{
+		fprintf(stderr,"%s is not a genprog checkpoint\n",filename);
+		exit(EXIT_FAILURE);
+		}
+	h = (const CheckpointHeader*)mmap(NULL,(size_t)st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+	close(fd);
+	if(h==MAP_FAILED) THROW_ERROR("mmap failed");
+	madvise((void*)h,(size_t)st.st_size,MADV_SEQUENTIAL);
+	if(memcmp(h->magic,CHECKPOINT_MAGIC,sizeof(CHECKPOINT_MAGIC))!=0 ||
+		h->version!=CHECKPOINT_VERSION ||
+		h->float_size!=sizeof(floating_t) ||
+		h->little_endian!=SheetCacheLittleEndian())
+		{
+		fprintf(stderr,"%s is not a genprog checkpoint of this version or of this architecture\n",filename);
+		exit(EXIT_FAILURE);
+		}
+	CheckpointSettingsInit(config,&settings);
+	if(h->random_kind!=(uint64_t)config->random.kind ||
+		memcmp(&settings,&(h->settings),sizeof(CheckpointSettings))!=0)
+		{
+		fprintf(stderr,"%s was written with other options or another dataset\n",filename);
+		exit(EXIT_FAILURE);
+		}
+	config->curr_generations = h->generation;
+	memcpy(config->random.s,h->random,sizeof(h->random));
+	p = (const char*)&h[1];
+	end = &((const char*)h)[st.st_size];
+	*best = NULL;
+	if(h->has_best && (*best = CheckpointGenomeRead(config,&p,end))==NULL)
+		{
+		fprintf(stderr,"%s: bad genome\n",filename);
+		exit(EXIT_FAILURE);
+		}
+	gen = GenerationNew1(config);
+	for(i=0;i< h->genome_count;++i)
+		{
+		GenomePtr g = CheckpointGenomeRead(config,&p,end);
+		if(g==NULL)
+			{
+			fprintf(stderr,"%s: bad genome\n",filename);
+			exit(EXIT_FAILURE);
+			}
+		GenerationAdd(gen,GenomeMoveTo(g,arena));
+		}
+	if(p!=end)
+		{
+		fprintf(stderr,"%s: bad size\n",filename);
+		exit(EXIT_FAILURE);
+		}
+	munmap((void*)h,(size_t)st.st_size);
+	return gen;
+	}
+
+/**
+ * Background writer of the best genome, see --save-interval. ResultWriterSubmit
+ * only keeps a copy of the genome: the files are written by the thread of the
+ * writer. A genome submitted while another one is waiting replaces it, and two
+ * writes are separated by at least 'interval' seconds. ResultWriterFree writes
+ * the last genome without waiting. The checkpoints (see ResultWriterCheckpoint)
+ * are written as soon as possible.
+ */
+typedef struct result_writer_t
+	{
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	/* main config: the config of an island may be released before the genome is written */
+	ConfigPtr config;
+	/* next genome to write, or NULL */
+	GenomePtr pending;
+	/* next checkpoint to write, or NULL. See CheckpointSerialize */
+	void* checkpoint;
+	size_t checkpoint_length;
+	/* minimal time between two writes, in seconds */
+	double interval;
+	/* time of the last write, see ResultWriterNow */
+	double last_write;
+	boolean_t shutdown;
+	} ResultWriter,*ResultWriterPtr;
+
+static double ResultWriterNow(void)
+	{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return (double)ts.tv_sec + ts.tv_nsec*1E-9;
+	}
+
+static void* ResultWriterMain(void* arg)
+	{
+	ResultWriterPtr w=(ResultWriterPtr)arg;
+	pthread_mutex_lock(&w->lock);
+	for(;;)
+		{
+		GenomePtr g;
+		double wait;
+		if(w->checkpoint!=NULL)
+			{
+			void* buf = w->checkpoint;
+			w->checkpoint = NULL;
+			pthread_mutex_unlock(&w->lock);
+			CheckpointWriteFile(w->config->checkpoint_filename,buf,w->checkpoint_length);
+			free(buf);
+			pthread_mutex_lock(&w->lock);
+			continue;
+			}
+		if(w->pending==NULL)
+			{
+			if(w->shutdown) break;
+			pthread_cond_wait(&w->cond,&w->lock);
+			continue;
+			}
+		wait = w->last_write + w->interval - ResultWriterNow();
+		if(wait>0.0 && !w->shutdown)
+			{
+			struct timespec ts;
+			clock_gettime(CLOCK_MONOTONIC,&ts);
+			ts.tv_sec += (time_t)wait;
+			ts.tv_nsec += (long)((wait-(double)(time_t)wait)*1E9);
+			if(ts.tv_nsec>=1000000000L)
+				{
+				ts.tv_sec++;
+				ts.tv_nsec-=1000000000L;
+				}
+			pthread_cond_timedwait(&w->cond,&w->lock,&ts);
+			continue;
+			}
+		g = w->pending;
+		w->pending = NULL;
+		pthread_mutex_unlock(&w->lock);
+		GenomeSave(g);
+		GenomeFree(g);
+		pthread_mutex_lock(&w->lock);
+		w->last_write = ResultWriterNow();
+		}
+	pthread_mutex_unlock(&w->lock);
+	return NULL;
+	}
+
+static ResultWriterPtr ResultWriterNew(ConfigPtr config)
+	{
+	pthread_condattr_t attr;
+	ResultWriterPtr w=(ResultWriterPtr)calloc(1,sizeof(ResultWriter));
+	if(w==NULL) THROW_ERROR("boum");
+	w->config = config;
+	w->interval = config->save_interval;
+	w->last_write = ResultWriterNow()-w->interval;
+	pthread_mutex_init(&w->lock,NULL);
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr,CLOCK_MONOTONIC);
+	pthread_cond_init(&w->cond,&attr);
+	pthread_condattr_destroy(&attr);
+	if(pthread_create(&w->thread,NULL,ResultWriterMain,w)!=0) THROW_ERROR("Cannot create thread");
+	return w;
+	}
+
+/** the genome will be saved by the writer, see GenomeSave */
+static void ResultWriterSubmit(ResultWriterPtr w,const GenomePtr g)
+	{
+	GenomePtr copy;
+	GenomePtr previous;
+	/* the writer only saves the checkpoints */
+	if(w->config->output_filename==NULL) return;
+	copy = GenomeClone(g);
+	copy->config = w->config;
+	pthread_mutex_lock(&w->lock);
+	previous = w->pending;
+	w->pending = copy;
+	pthread_cond_signal(&w->cond);
+	pthread_mutex_unlock(&w->lock);
+	GenomeFree(previous);
+	}
+
+/** the checkpoint 'buf' will be written and released by the writer, see CheckpointWriteFile */
+static void ResultWriterCheckpoint(ResultWriterPtr w,void* buf,size_t length)
+	{
+	void* previous;
+	pthread_mutex_lock(&w->lock);
+	previous = w->checkpoint;
+	w->checkpoint = buf;
+	w->checkpoint_length = length;
+	pthread_cond_signal(&w->cond);
+	pthread_mutex_unlock(&w->lock);
+	free(previous);
+	}
+
+/** writes the last genome and the last checkpoint, and stops the writer */
+static void ResultWriterFree(ResultWriterPtr w)
+	{
+	if(w==NULL) return;
+	pthread_mutex_lock(&w->lock);
+	w->shutdown=1;
+	pthread_cond_signal(&w->cond);
+	pthread_mutex_unlock(&w->lock);
+	pthread_join(w->thread,NULL);
+	pthread_cond_destroy(&w->cond);
+	pthread_mutex_destroy(&w->lock);
+	free(w);
+	}
+
+/**
+ * Thread pool with work stealing. ThreadPoolRun splits the tasks [0,n) in one
+ * contiguous range per worker; a worker takes its tasks from the front of its
+ * own range and, when it is empty, steals the back half of another range.
+ * The calling thread is worker 0.
+ */
+typedef struct work_range_t
+	{
+	pthread_mutex_t lock;
+	size_t begin;
+	size_t end;
+	} WorkRange,*WorkRangePtr;
+
+typedef struct thread_pool_t
+	{
+	size_t num_threads;
+	pthread_t* threads;
+	WorkRangePtr ranges;
+	pthread_mutex_t lock;
+	pthread_cond_t start_cond;
+	pthread_cond_t done_cond;
+	/* incremented by each call to ThreadPoolRun */
+	unsigned long batch;
+	/* number of workers still busy with the current batch */
+	size_t running;
+	boolean_t shutdown;
+	void (*task)(void* ctx,size_t index);
+	void* ctx;
+	} ThreadPool,*ThreadPoolPtr;
+
+typedef struct thread_pool_worker_t
+	{
+	ThreadPoolPtr pool;
+	size_t index;
+	} ThreadPoolWorker;
+
+/** pops the next task of the worker, steals one if needed. Returns 0 if there is no task left */
+static boolean_t ThreadPoolNext(ThreadPoolPtr pool,size_t worker,size_t* task)
+	{
+	size_t i;
+	WorkRangePtr own=&(pool->ranges[worker]);
+	for(;;)
+		{
+		boolean_t stolen=0;
+		pthread_mutex_lock(&own->lock);
+		if(own->begin < own->end)
+			{
+			*task = own->begin++;
+			pthread_mutex_unlock(&own->lock);
+			return 1;
+			}
+		pthread_mutex_unlock(&own->lock);
+		
+		for(i=1;i< pool->num_threads && !stolen;++i)
+			{
+			WorkRangePtr victim=&(pool->ranges[(worker+i)%pool->num_threads]);
+			size_t begin=0UL,end=0UL;
+			pthread_mutex_lock(&victim->lock);
+			if(victim->begin < victim->end)
+				{
+				end = victim->end;
+				begin = victim->end - (victim->end - victim->begin + 1)/2;
+				victim->end = begin;
+				stolen=1;
+				}
+			pthread_mutex_unlock(&victim->lock);
+			if(stolen)
+				{
+				pthread_mutex_lock(&own->lock);
+				own->begin = begin;
+				own->end = end;
+				pthread_mutex_unlock(&own->lock);
+				}
+			}
+		if(!stolen) return 0;
+		}
+	}
+
+static void ThreadPoolWork(ThreadPoolPtr pool,size_t worker)
+	{
+	size_t task;
+	while(ThreadPoolNext(pool,worker,&task))
+		{
+		pool->task(pool->ctx,task);
+		}
+	pthread_mutex_lock(&pool->lock);
+	pool->running--;
+	if(pool->running==0UL) pthread_cond_broadcast(&pool->done_cond);
+	pthread_mutex_unlock(&pool->lock);
+	}
+
+static void* ThreadPoolMain(void* arg)
+	{
+	ThreadPoolWorker* w=(ThreadPoolWorker*)arg;
+	ThreadPoolPtr pool=w->pool;
+	unsigned long batch=0UL;
+	thread_worker = w->index;
+	for(;;)
+		{
+		pthread_mutex_lock(&pool->lock);
+		while(!pool->shutdown && pool->batch==batch)
+			{
+			pthread_cond_wait(&pool->start_cond,&pool->lock);
+			}
+		if(pool->shutdown)
+			{
+			pthread_mutex_unlock(&pool->lock);
+			break;
+			}
+		batch = pool->batch;
+		pthread_mutex_unlock(&pool->lock);
+		ThreadPoolWork(pool,w->index);
+		}
+	free(w);
+	return NULL;
+	}
+
+static ThreadPoolPtr ThreadPoolNew(size_t num_threads)
+	{
+	size_t i;
+	ThreadPoolPtr pool=(ThreadPoolPtr)calloc(1,sizeof(ThreadPool));
+	if(pool==NULL) THROW_ERROR("boum");
+	pool->num_threads = num_threads;
+	pool->ranges = (WorkRangePtr)calloc(num_threads,sizeof(WorkRange));
+	pool->threads = (pthread_t*)calloc(num_threads,sizeof(pthread_t));
+	if(pool->ranges==NULL || pool->threads==NULL) THROW_ERROR("boum");
+	pthread_mutex_init(&pool->lock,NULL);
+	pthread_cond_init(&pool->start_cond,NULL);
+	pthread_cond_init(&pool->done_cond,NULL);
+	for(i=0;i< num_threads;++i)
+		{
+		pthread_mutex_init(&pool->ranges[i].lock,NULL);
+		}
+	for(i=1;i< num_threads;++i)
+		{
+		ThreadPoolWorker* w=(ThreadPoolWorker*)calloc(1,sizeof(ThreadPoolWorker));
+		if(w==NULL) THROW_ERROR("boum");
+		w->pool = pool;
+		w->index = i;
+		if(pthread_create(&pool->threads[i],NULL,ThreadPoolMain,w)!=0) THROW_ERROR("Cannot create thread");
+		}
+	return pool;
+	}
+
+/** runs task(ctx,index) for each index in [0,n), returns when all the tasks are done */
+static void ThreadPoolRun(ThreadPoolPtr pool,size_t n,void (*task)(void*,size_t),void* ctx)
+	{
+	size_t i;
+	for(i=0;i< pool->num_threads;++i)
+		{
+		pthread_mutex_lock(&pool->ranges[i].lock);
+		pool->ranges[i].begin = (n*i)/pool->num_threads;
+		pool->ranges[i].end = (n*(i+1))/pool->num_threads;
+		pthread_mutex_unlock(&pool->ranges[i].lock);
+		}
+	pthread_mutex_lock(&pool->lock);
+	pool->task = task;
+	pool->ctx = ctx;
+	pool->running = pool->num_threads;
+	pool->batch++;
+	pthread_cond_broadcast(&pool->start_cond);
+	pthread_mutex_unlock(&pool->lock);
+	
+	ThreadPoolWork(pool,0);
+	
+	pthread_mutex_lock(&pool->lock);
+	while(pool->running>0UL)
+		{
+		pthread_cond_wait(&pool->done_cond,&pool->lock);
+		}
+	pthread_mutex_unlock(&pool->lock);
+	}
+
+static void ThreadPoolFree(ThreadPoolPtr pool)
+	{
+	size_t i;
+	if(pool==NULL) return;
+	pthread_mutex_lock(&pool->lock);
+	pool->shutdown=1;
+	pthread_cond_broadcast(&pool->start_cond);
+	pthread_mutex_unlock(&pool->lock);
+	for(i=1;i< pool->num_threads;++i)
+		{
+		pthread_join(pool->threads[i],NULL);
+		}
+	for(i=0;i< pool->num_threads;++i)
+		{
+		pthread_mutex_destroy(&pool->ranges[i].lock);
+		}
+	pthread_mutex_destroy(&pool->lock);
+	pthread_cond_destroy(&pool->start_cond);
+	pthread_cond_destroy(&pool->done_cond);
+	free(pool->ranges);
+	free(pool->threads);
+	free(pool);
+	}
+
+/**
+ * structural check of a new genome, before any row is evaluated: the tree
+ * is compiled, which walks it once, and a truncated tree is rejected.
+ * With remove_introns, the trailing nodes not used by the tree are removed.
+ */
+static boolean_t GenomeCheck(GenomePtr g)
+	{
+	ProgramPtr prog = GenomeCompile(g);
+	if(!prog->valid) return 0;
+	if(g->config->remove_introns) g->node_count = prog->node_count;
+	return 1;
+	}
+
+/** evaluates the child on all the rows. returns NULL if the child is invalid */
+static GenomePtr GenomePromote(GenomePtr g,SelectionPtr selection)
+	{
+	g->fitness = NAN;
+	GenomeEvalCached(g,(g->config->early_abort?selection:NULL));
+	if( g->bad_flag )
+		{
+		GenomeFree(g);
+		return NULL;
+		}
+	return g;
+	}
+
+/**
+ * creates the child of gi and gj and evaluates it. With staged evaluation,
+ * the child is only evaluated on config->sample, see GenerationPromote.
+ * returns NULL if the child is invalid.
+ */
+static GenomePtr GenomeOffspring(ConfigPtr config,GenomePtr gi,GenomePtr gj,SelectionPtr selection)
+	{
+	GenomePtr newgen =  GenomeXCross(config,gi,gj);
+	
+	if(newgen==NULL ||
+		GenomeSize(newgen)==0 ||
+		GenomeSize(newgen) < config->min_base_per_genome ||
+		GenomeSize(newgen) > config->max_base_per_genome ||
+		(config->remove_clone && (GenomeEquals(newgen,gi) || GenomeEquals(newgen,gj)) ) ||
+		!GenomeCheck(newgen)
+		)
+		{
+		GenomeFree(newgen);
+		return NULL;
+		}
+	newgen->generation = config->curr_generations;
+	if(config->sample!=NULL)
+		{
+		GenomeEval(newgen,config->sample,NULL);
+		if( newgen->bad_flag )
+			{
+			GenomeFree(newgen);
+			return NULL;
+			}
+		return newgen;
+		}
+	/* evaluated with the other children, see GenerationPromote */
+	if(config->stream_block_rows>0UL) return newgen;
+	return GenomePromote(newgen,selection);
+	}
+
+/** true if the children are returned by OffspringSelect and evaluated after their creation, see GenerationPromote */
+static boolean_t OffspringDeferred(ConfigPtr config)
+	{
+	return config->sample!=NULL || config->stream_block_rows>0UL;
+	}
+
+/**
+ * creates the child of gi and gj. With staged or out-of-core evaluation,
+ * the child is returned. Otherwise it is given to the selection with the rank 'index'
+ * and NULL is returned. The memory of a rejected child is given back to
+ * the arena of the thread.
+ */
+static GenomePtr OffspringSelect(ConfigPtr config,GenomePtr gi,GenomePtr gj,size_t index,SelectionPtr selection)
+	{
+	ArenaMark mark = ArenaGetMark(thread_arena);
+	GenomePtr child = GenomeOffspring(config,gi,gj,selection);
+	if(child!=NULL && OffspringDeferred(config)) return child;
+	if(child==NULL || !SelectionAdd(selection,child,index))
+		{
+		ArenaRelease(thread_arena,&mark);
+		}
+	return NULL;
+	}
+
+/** returns the best of config->tournament_size genomes drawn at random in 'gen' */
+static GenomePtr GenerationTournament(ConfigPtr config,GenerationPtr gen)
+	{
+	size_t k;
+	GenomePtr best=NULL;
+	for(k=0;k< config->tournament_size;++k)
+		{
+		GenomePtr g = GenerationAt(gen,RANDOM_SIZE_T(config,GenerationCount(gen)));
+		if(best==NULL || GenomeCompare(g,best)<0) best=g;
+		}
+	return best;
+	}
+
+/**
+ * creates the child number 'index' of 'gen'. With the default engine, the
+ * parents are the pair (i,j) with index=i*n+j. With --steady-state, they
+ * are chosen by tournament; the rank of the child is then placed after
+ * the genomes of 'gen', see GenerationSteadyState. See OffspringSelect.
+ */
+static GenomePtr GenerationOffspring(ConfigPtr config,GenerationPtr gen,size_t index,SelectionPtr selection)
+	{
+	size_t n = GenerationCount(gen);
+	size_t i = index/n, j=index%n;
+	if(config->steady_state)
+		{
+		GenomePtr gi = GenerationTournament(config,gen);
+		GenomePtr gj = GenerationTournament(config,gen);
+		return OffspringSelect(config,gi,gj,n+index,selection);
+		}
+	if( i == j && !config->enable_self_self) return NULL;
+	return OffspringSelect(config,GenerationAt(gen,i),GenerationAt(gen,j),index,selection);
+	}
+
+/** all the crossovers of one generation, run by the thread pool */
+typedef struct offspring_ctx_t
+	{
+	ConfigPtr config;
+	GenerationPtr gen;
+	/* random state of the generation, each task has its own stream of it */
+	Random random;
+	/* with staged or out-of-core evaluation, one child (or NULL) per ordered pair of parents */
+	GenomePtr* children;
+	/* best children */
+	SelectionPtr selection;
+	} OffspringContext;
+
+static void OffspringTask(void* arg,size_t index)
+	{
+	OffspringContext* ctx=(OffspringContext*)arg;
+	Random random;
+	GenomePtr child;
+	RandomStream(&random,&(ctx->random),index);
+	thread_random = &random;
+	thread_arena = ctx->config->nurseries[thread_worker];
+	child = GenerationOffspring(ctx->config,ctx->gen,index,ctx->selection);
+	if(ctx->children!=NULL) ctx->children[index] = child;
+	thread_arena = NULL;
+	thread_random = NULL;
+	}
+
+/** a child of the generation and its rank in the generation */
+typedef struct ranked_genome_t
+	{
+	GenomePtr genome;
+	size_t index;
+	} RankedGenome;
+
+static int _RankedGenomeCompare(const void* a,const void* b)
+	{
+	const RankedGenome* r1=(const RankedGenome*)a;
+	const RankedGenome* r2=(const RankedGenome*)b;
+	int i = GenomeCompare(r1->genome,r2->genome);
+	if(i!=0) return i;
+	return r1->index < r2->index ? -1 : (r1->index > r2->index ? 1 : 0);
+	}
+
+/** full evaluation of the children promoted by GenerationPromote, run by the thread pool */
+typedef struct promote_ctx_t
+	{
+	GenerationPtr gen;
+	SelectionPtr selection;
+	/* rank, in the selection, of the first child */
+	size_t first_index;
+	} PromoteContext;
+
+static void PromoteTask(void* arg,size_t index)
+	{
+	PromoteContext* ctx=(PromoteContext*)arg;
+	GenomePtr g = ctx->gen->genomes[index];
+	if(g==NULL) return;
+	g = GenomePromote(g,ctx->selection);
+	if(g!=NULL) SelectionAdd(ctx->selection,g,ctx->first_index+index);
+	}
+
+/**
+ * out-of-core evaluation, see --stream-block-rows. The rows are read by blocks
+ * and all the genomes are evaluated on a block before the next one, so that a
+ * block is read once per generation instead of once per genome. With
+ * --read-cache, the next block is prefetched and the previous one released.
+ */
+typedef struct stream_ctx_t
+	{
+	SpreadSheetPtr sheet;
+	GenomePtr* genomes;
+	/* sums of the genomes, see GenomeEval */
+	EvalSums* sums;
+	/* 1 if the genome is evaluated */
+	char* pending;
+	/* rows of the current block */
+	size_t begin;
+	size_t end;
+	} StreamContext;
+
+static void StreamTask(void* arg,size_t index)
+	{
+	StreamContext* ctx=(StreamContext*)arg;
+	if(!ctx->pending[index] || EvalSumsDone(&(ctx->sums[index]))) return;
+	GenomeEvalRange(ctx->genomes[index],ctx->sheet,&(ctx->sums[index]),ctx->begin,ctx->end,NULL,NULL);
+	}
+
+/** evaluates the 'n' genomes (or NULL) on all the rows, block by block. Uses the fitness cache */
+static void GenomesEvalStreaming(ConfigPtr config,GenomePtr* genomes,size_t n)
+	{
+	size_t i;
+	StreamContext ctx;
+	const size_t nRows = SpreadSheetRows(config->spreadsheet);
+	const size_t block = config->stream_block_rows;
+	uint64_t* hashes = (uint64_t*)calloc(n,sizeof(uint64_t));
+	ctx.sheet = config->spreadsheet;
+	ctx.genomes = genomes;
+	ctx.sums = (EvalSums*)calloc(n,sizeof(EvalSums));
+	ctx.pending = (char*)calloc(n,sizeof(char));
+	if(hashes==NULL || ctx.sums==NULL || ctx.pending==NULL) THROW_ERROR("boum");
+	for(i=0;i< n;++i)
+		{
+		GenomePtr g = genomes[i];
+		if(g==NULL) continue;
+		g->fitness = NAN;
+		if(!GenomeCompile(g)->valid)
+			{
+			g->bad_flag=1;
+			continue;
+			}
+		if(config->fitness_cache!=NULL && GenomeCacheGet(g,&hashes[i])) continue;
+		EvalSumsInit(&(ctx.sums[i]),g,ctx.sheet);
+		ctx.pending[i]=1;
+		}
+	for(ctx.begin=0UL;ctx.begin< nRows;ctx.begin=ctx.end)
+		{
+		ctx.end = MIN(ctx.begin+block,nRows);
+		SpreadSheetAdvise(ctx.sheet,ctx.end,MIN(ctx.end+block,nRows),MADV_WILLNEED);
+		if(config->thread_pool!=NULL)
+			{
+			ThreadPoolRun(config->thread_pool,n,StreamTask,&ctx);
+			}
+		else
+			{
+			for(i=0;i< n;++i) StreamTask(&ctx,i);
+			}
+		SpreadSheetAdvise(ctx.sheet,ctx.begin,ctx.end,MADV_DONTNEED);
+		}
+	for(i=0;i< n;++i)
+		{
+		if(!ctx.pending[i]) continue;
+		EvalSumsFinish(genomes[i],&(ctx.sums[i]));
+		if(config->fitness_cache!=NULL) GenomeCachePut(genomes[i],hashes[i]);
+		}
+	free(ctx.pending);
+	free(ctx.sums);
+	free(hashes);
+	}
+
+/**
+ * the children of gen1 were returned by OffspringSelect. With staged evaluation,
+ * they have been evaluated on config->sample and only the best fraction
+ * (config->sample_promotion, and at least min_genomes_per_generation) are
+ * promoted, the others are discarded. The promoted children are evaluated on
+ * all the rows and given to the selection, with a rank starting from
+ * 'first_index'. gen1 is empty on exit.
+ */
+static void GenerationPromote(ConfigPtr config,GenerationPtr gen1,SelectionPtr selection,size_t first_index)
+	{
+	size_t i,n=GenerationCount(gen1);
+	PromoteContext ctx;
+	if(n==0UL) return;
+	if(config->sample!=NULL)
+		{
+		RankedGenome* ranked;
+		size_t n_promoted = (size_t)ceil(config->sample_promotion*n);
+		if(n_promoted < (size_t)config->min_genomes_per_generation) n_promoted = config->min_genomes_per_generation;
+		if(n_promoted > n) n_promoted = n;
+		
+		ranked=(RankedGenome*)calloc(n,sizeof(RankedGenome));
+		if(ranked==NULL) THROW_ERROR("boum");
+		for(i=0;i< n;++i)
+			{
+			ranked[i].genome = gen1->genomes[i];
+			ranked[i].index = i;
+			}
+		qsort((void*)ranked,n,sizeof(RankedGenome),_RankedGenomeCompare);
+		for(i=n_promoted;i< n;++i)
+			{
+			GenomeFree(ranked[i].genome);
+			gen1->genomes[ranked[i].index]=NULL;
+			}
+		free(ranked);
+		}
+	
+	if(config->stream_block_rows>0UL)
+		{
+		GenomesEvalStreaming(config,gen1->genomes,n);
+		for(i=0;i< n;++i)
+			{
+			GenomePtr g = gen1->genomes[i];
+			if(g==NULL) continue;
+			if(g->bad_flag)
+				{
+				GenomeFree(g);
+				continue;
+				}
+			SelectionAdd(selection,g,first_index+i);
+			}
+		gen1->genome_count=0UL;
+		return;
+		}
+	
+	ctx.gen = gen1;
+	ctx.selection = selection;
+	ctx.first_index = first_index;
+	if(config->thread_pool!=NULL)
+		{
+		ThreadPoolRun(config->thread_pool,n,PromoteTask,&ctx);
+		}
+	else
+		{
+		for(i=0;i< n;++i)
+			{
+			PromoteTask(&ctx,i);
+			}
+		}
+	gen1->genome_count=0UL;
+	}
+
+/**
+ * --stream-block-rows: evaluates the new genomes of the population (see
+ * EvalTask) block by block.
+ */
+static void GenerationEvalStreaming(ConfigPtr config,GenerationPtr gen)
+	{
+	size_t i,n=0UL;
+	GenomePtr* pending=(GenomePtr*)calloc(MAX(GenerationCount(gen),1UL),sizeof(GenomePtr));
+	if(pending==NULL) THROW_ERROR("boum");
+	for(i=0;i< GenerationCount(gen);++i)
+		{
+		GenomePtr g = gen->genomes[i];
+		if(!isnan(g->fitness) || g->bad_flag) continue;
+		if(!GenomeCheck(g))
+			{
+			g->bad_flag = 1;
+			continue;
+			}
+		pending[n++]=g;
+		}
+	GenomesEvalStreaming(config,pending,n);
+	free(pending);
+	}
+
+/** evaluation of the new genomes of the population, run by the thread pool */
+static void EvalTask(void* arg,size_t index)
+	{
+	GenerationPtr gen=(GenerationPtr)arg;
+	GenomePtr g = gen->genomes[index];
+	if(!isnan(g->fitness) || g->bad_flag) return;
+	if(!GenomeCheck(g))
+		{
+		g->bad_flag = 1;
+		return;
+		}
+	GenomeEvalCached(g,NULL);
+	}
+
+/**
+ * --steady-state: the children of the round were given to the selection,
+ * which holds max_genomes_per_generation genomes. The genomes of the
+ * population are now given to the selection too, with a rank lower than
+ * the children: a child replaces a genome of the population only if it is
+ * better. 'gen' is empty on exit.
+ */
+static void GenerationSteadyState(GenerationPtr gen,SelectionPtr selection)
+	{
+	size_t i;
+	for(i=0;i< GenerationCount(gen);++i)
+		{
+		GenomePtr g = gen->genomes[i];
+		if(g->bad_flag)
+			{
+			GenomeFree(g);
+			continue;
+			}
+		SelectionAdd(selection,g,i);
+		}
+	gen->genome_count=0UL;
+	}
+
+/**
+ * Island model, see --islands. Each island evolves its own population in its
+ * own thread, with its own copy of the config (and so of the random state).
+ * Every migration_interval generations, an island sends a batch holding a copy
+ * of its best genomes to the next island (in a ring) through a lock-free
+ * single-producer single-consumer queue, and waits for the batch sent by the
+ * previous island for the same generation. The best genomes of the islands are
+ * compared generation by generation (see IslandReport), so the result doesn't
+ * depend on the scheduling of the threads.
+ */
+#define MIGRATION_RING_SIZE 64
+
+/** the migrants sent by an island at a generation */
+typedef struct migration_batch_t
+	{
+	long generation;
+	size_t count;
+	GenomePtr* genomes;
+	} MigrationBatch,*MigrationBatchPtr;
+
+/** a better genome found by an island, not compared yet with the other islands */
+typedef struct island_improvement_t
+	{
+	long generation;
+	GenomePtr genome;
+	struct island_improvement_t* next;
+	} IslandImprovement,*IslandImprovementPtr;
+
+typedef struct migration_ring_t
+	{
+	MigrationBatchPtr items[MIGRATION_RING_SIZE];
+	/* next item to pop, only written by the consumer */
+	size_t head;
+	/* next item to push, only written by the producer */
+	size_t tail;
+	} MigrationRing,*MigrationRingPtr;
+
+typedef struct island_t
+	{
+	size_t index;
+	/* copy of the main config */
+	Config config;
+	pthread_t thread;
+	/* migrants sent by the previous island */
+	MigrationRing inbox;
+	/* island receiving the migrants of this one */
+	struct island_t* next;
+	/* state shared by all the islands */
+	struct islands_t* shared;
+	/* the fields below are protected by shared->lock, see IslandReport */
+	/* last generation reported, -1 if none */
+	long reported;
+	/* better genomes found, oldest first, and the last one */
+	IslandImprovementPtr improvements;
+	IslandImprovementPtr last_improvement;
+	/* best genome of this island at the last compared generation, or NULL */
+	GenomePtr current;
+	} Island,*IslandPtr;
+
+typedef struct islands_t
+	{
+	pthread_mutex_t lock;
+	/* all the islands */
+	struct island_t* islands;
+	size_t num_islands;
+	/* next generation to compare, see IslandReport */
+	long compared;
+	/* best genome of all the islands */
+	GenomePtr best;
+	/* set when the min fitness is reached, read without the lock while waiting for the migrants */
+	boolean_t done;
+	} Islands,*IslandsPtr;
+
+static void MigrationBatchFree(MigrationBatchPtr b)
+	{
+	size_t i;
+	if(b==NULL) return;
+	for(i=0;i< b->count;++i) GenomeFree(b->genomes[i]);
+	free(b->genomes);
+	free(b);
+	}
+
+/** returns 0 if the queue is full */
+static boolean_t MigrationRingPush(MigrationRingPtr r,MigrationBatchPtr g)
+	{
+	size_t tail = __atomic_load_n(&r->tail,__ATOMIC_RELAXED);
+	size_t head = __atomic_load_n(&r->head,__ATOMIC_ACQUIRE);
+	if(tail-head >= MIGRATION_RING_SIZE) return 0;
+	r->items[tail%MIGRATION_RING_SIZE] = g;
+	__atomic_store_n(&r->tail,tail+1,__ATOMIC_RELEASE);
+	return 1;
+	}
+
+/** returns NULL if the queue is empty */
+static MigrationBatchPtr MigrationRingPop(MigrationRingPtr r)
+	{
+	MigrationBatchPtr g;
+	size_t head = __atomic_load_n(&r->head,__ATOMIC_RELAXED);
+	size_t tail = __atomic_load_n(&r->tail,__ATOMIC_ACQUIRE);
+	if(head==tail) return NULL;
+	g = r->items[head%MIGRATION_RING_SIZE];
+	__atomic_store_n(&r->head,head+1,__ATOMIC_RELEASE);
+	return g;
+	}
+
+static boolean_t IslandsDone(IslandsPtr shared)
+	{
+	return __atomic_load_n(&(shared->done),__ATOMIC_ACQUIRE);
+	}
+
+/**
+ * sends a copy of the best genomes of 'gen' (sorted) to the next island and
+ * receives the migrants of the previous island for the same generation. Only
+ * waits at the generations of migration, and not once the evolution is done.
+ */
+static void IslandMigrate(IslandPtr island,GenerationPtr gen)
+	{
+	size_t i;
+	MigrationBatchPtr batch;
+	ConfigPtr config = &(island->config);
+	if(config->curr_generations==0L || config->curr_generations % config->migration_interval != 0L) return;
+	batch = (MigrationBatchPtr)calloc(1,sizeof(MigrationBatch));
+	if(batch==NULL) THROW_ERROR("boum");
+	batch->generation = config->curr_generations;
+	batch->count = MIN(config->migration_size,GenerationCount(gen));
+	batch->genomes = (GenomePtr*)calloc(MAX(batch->count,1UL),sizeof(GenomePtr));
+	if(batch->genomes==NULL) THROW_ERROR("boum");
+	for(i=0;i< batch->count;++i)
+		{
+		batch->genomes[i] = GenomeClone(GenerationAt(gen,i));
+		}
+	while(!MigrationRingPush(&(island->next->inbox),batch))
+		{
+		if(IslandsDone(island->shared))
+			{
+			MigrationBatchFree(batch);
+			return;
+			}
+		sched_yield();
+		}
+	while((batch=MigrationRingPop(&(island->inbox)))==NULL)
+		{
+		if(IslandsDone(island->shared)) return;
+		sched_yield();
+		}
+	/* one batch per generation of migration, in order */
+	if(batch->generation!=config->curr_generations) THROW_ERROR("bad migration batch");
+	for(i=0;i< batch->count;++i)
+		{
+		GenomePtr g = batch->genomes[i];
+		g->config = config;
+		GenerationAdd(gen,g);
+		}
+	batch->count=0UL;
+	MigrationBatchFree(batch);
+	}
+
+/**
+ * called by each island at the end of each generation. Once all the islands
+ * have reported a generation, their best genomes at this generation are
+ * compared, the lowest island index winning ties: the best of all the islands
+ * is printed and saved if it is better than the previous one. The generations
+ * are compared in order, by the island reporting last.
+ * returns 1 if the evolution must stop.
+ */
+static boolean_t IslandReport(IslandPtr island)
+	{
+	size_t i;
+	boolean_t done;
+	IslandsPtr shared = island->shared;
+	pthread_mutex_lock(&shared->lock);
+	island->reported = island->config.curr_generations;
+	while(!shared->done)
+		{
+		IslandPtr winner=NULL;
+		for(i=0;i< shared->num_islands;++i)
+			{
+			if(shared->islands[i].reported < shared->compared) break;
+			}
+		if(i< shared->num_islands) break;
+		for(i=0;i< shared->num_islands;++i)
+			{
+			IslandPtr other=&(shared->islands[i]);
+			IslandImprovementPtr m;
+			while((m=other->improvements)!=NULL && m->generation<=shared->compared)
+				{
+				other->improvements = m->next;
+				if(other->improvements==NULL) other->last_improvement=NULL;
+				GenomeFree(other->current);
+				other->current = m->genome;
+				free(m);
+				}
+			if(other->current!=NULL && (winner==NULL || winner->current->fitness > other->current->fitness))
+				{
+				winner = other;
+				}
+			}
+		shared->compared++;
+		if(winner==NULL || (shared->best!=NULL && shared->best->fitness <= winner->current->fitness)) continue;
+		GenomeFree(shared->best);
+		shared->best = GenomeClone(winner->current);
+		fprintf(stdout,"ISLAND=%d\t",(int)winner->index);
+		GenomePrint(shared->best,stdout);
+		if(island->config.writer!=NULL)
+			{
+			ResultWriterSubmit(island->config.writer,shared->best);
+			}
+		if(shared->best->fitness < island->config.min_fitness)
+			{
+			fprintf(stderr,"min fitness reached\n");
+			__atomic_store_n(&(shared->done),1,__ATOMIC_RELEASE);
+			}
+		}
+	done = shared->done;
+	pthread_mutex_unlock(&shared->lock);
+	return done;
+	}
+
+/**
+ * Distributed islands, see --coordinator and --connect. Each worker process
+ * evolves one island. The coordinator forwards the migrants of a worker to
+ * the next worker (in a ring), keeps the best genome of all the workers and
+ * tells them to stop when the min fitness is reached. A message is a
+ * MessageHeader followed by 'length' bytes. Genomes are sent in the byte
+ * order of the host: all the processes must run on the same architecture.
+ */
+enum	{
+	MESSAGE_HELLO=1,
+	MESSAGE_MIGRANT,
+	MESSAGE_BEST,
+	MESSAGE_DONE,
+	MESSAGE_BYE
+	};
+
+#define MESSAGE_MAX_LENGTH (64U*1024U*1024U)
+
+typedef struct message_header_t
+	{
+	uint32_t type;
+	uint32_t length;
+	} MessageHeader;
+
+/* serialized genome, followed by the bits of the node_count nodes */
+typedef struct genome_message_t
+	{
+	floating_t fitness;
+	int64_t generation;
+	uint64_t node_count;
+	} GenomeMessage;
+
+typedef struct remote_t
+	{
+	/* connection to the coordinator */
+	int fd;
+	/* island of this worker */
+	size_t index;
+	/* set when the coordinator sent MESSAGE_DONE or closed the connection */
+	boolean_t done;
+	} Remote,*RemotePtr;
+
+static boolean_t SocketWriteAll(int fd,const void* buf,size_t n)
+	{
+	const char* p=(const char*)buf;
+	while(n>0UL)
+		{
+		ssize_t w=send(fd,p,n,MSG_NOSIGNAL);
+		if(w<0)
+			{
+			if(errno==EINTR) continue;
+			return 0;
+			}
+		p+=w;
+		n-=(size_t)w;
+		}
+	return 1;
+	}
+
+static boolean_t SocketReadAll(int fd,void* buf,size_t n)
+	{
+	char* p=(char*)buf;
+	while(n>0UL)
+		{
+		ssize_t r=recv(fd,p,n,0);
+		if(r<0 && errno==EINTR) continue;
+		if(r<=0) return 0;
+		p+=r;
+		n-=(size_t)r;
+		}
+	return 1;
+	}
+
+static boolean_t MessageSend(int fd,uint32_t type,const void* payload,size_t length)
+	{
+	MessageHeader h;
+	h.type = type;
+	h.length = (uint32_t)length;
+	if(!SocketWriteAll(fd,&h,sizeof(MessageHeader))) return 0;
+	return SocketWriteAll(fd,payload,length);
+	}
+
+/** returns the payload of the next message, or NULL if the connection was closed */
+static void* MessageRecv(int fd,uint32_t* type,size_t* length)
+	{
+	MessageHeader h;
+	char* payload;
+	if(!SocketReadAll(fd,&h,sizeof(MessageHeader))) return NULL;
+	if(h.length > MESSAGE_MAX_LENGTH) return NULL;
+	payload=(char*)malloc(h.length+1U);
+	if(payload==NULL) THROW_ERROR("boum");
+	if(!SocketReadAll(fd,payload,h.length))
+		{
+		free(payload);
+		return NULL;
+		}
+	*type = h.type;
+	*length = h.length;
+	return payload;
+	}
+
+static void* GenomeSerialize(const GenomePtr g,size_t* length)
+	{
+	size_t i;
+	GenomeMessage m;
+	char* buf;
+	*length = sizeof(GenomeMessage)+g->node_count*sizeof(uint64_t);
+	buf=(char*)malloc(*length);
+	if(buf==NULL) THROW_ERROR("boum");
+	m.fitness = g->fitness;
+	m.generation = g->generation;
+	m.node_count = g->node_count;
+	memcpy(buf,&m,sizeof(GenomeMessage));
+	for(i=0;i< g->node_count;++i)
+		{
+		memcpy(&buf[sizeof(GenomeMessage)+i*sizeof(uint64_t)],&(g->nodes[i].bits),sizeof(uint64_t));
+		}
+	return buf;
+	}
+
+/** returns NULL if the payload is not a valid genome for 'config' */
+static GenomePtr GenomeDeserialize(ConfigPtr config,const void* payload,size_t length)
+	{
+	size_t i;
+	GenomeMessage m;
+	GenomePtr g;
+	const char* buf=(const char*)payload;
+	if(length < sizeof(GenomeMessage)) return NULL;
+	memcpy(&m,buf,sizeof(GenomeMessage));
+	if(m.node_count==0UL || m.node_count!=(length-sizeof(GenomeMessage))/sizeof(uint64_t) ||
+		length!=sizeof(GenomeMessage)+m.node_count*sizeof(uint64_t)) return NULL;
+	g=(GenomePtr)calloc(1,sizeof(Genome));
+	if(g==NULL) THROW_ERROR("boum");
+	g->config = config;
+	g->node_count = m.node_count;
+	g->nodes = (NodePtr)calloc(g->node_count,sizeof(Node));
+	if(g->nodes==NULL) THROW_ERROR("boum");
+	g->fitness = m.fitness;
+	g->generation = m.generation;
+	g->creation = time(NULL);
+	for(i=0;i< g->node_count;++i)
+		{
+		memcpy(&(g->nodes[i].bits),&buf[sizeof(GenomeMessage)+i*sizeof(uint64_t)],sizeof(uint64_t));
+		}
+	if(!GenomeNodesValid(config,g) || !GenomeCompile(g)->valid)
+		{
+		GenomeFree(g);
+		return NULL;
+		}
+	return g;
+	}
+
+/** opens a socket listening on, or connected to, 'address' (unix:PATH or HOST:PORT). returns -1 on failure */
+static int SocketOpen(const char* address,boolean_t server)
+	{
+	int fd;
+	if(strncmp(address,"unix:",5)==0)
+		{
+		struct sockaddr_un sa;
+		const char* path=&address[5];
+		if(strlen(path)>=sizeof(sa.sun_path))
+			{
+			errno=ENAMETOOLONG;
+			return -1;
+			}
+		memset((void*)&sa,0,sizeof(sa));
+		sa.sun_family=AF_UNIX;
+		strcpy(sa.sun_path,path);
+		fd=socket(AF_UNIX,SOCK_STREAM,0);
+		if(fd==-1) return -1;
+		if(server)
+			{
+			unlink(path);
+			if(bind(fd,(struct sockaddr*)&sa,sizeof(sa))==0 && listen(fd,SOMAXCONN)==0) return fd;
+			}
+		else if(connect(fd,(struct sockaddr*)&sa,sizeof(sa))==0)
+			{
+			return fd;
+			}
+		close(fd);
+		return -1;
+		}
+	else
+		{
+		int one=1;
+		struct addrinfo hints;
+		struct addrinfo* res;
+		struct addrinfo* ai;
+		char* host=strdup(address);
+		char* port;
+		if(host==NULL) THROW_ERROR("Out of memory");
+		port=strrchr(host,':');
+		if(port==NULL)
 			{
-			NodeInit(cfg,&(g->nodes[i]));
+			free(host);
+			errno=EINVAL;
+			return -1;
 			}
-		else
+		*port++=0;
+		memset((void*)&hints,0,sizeof(hints));
+		hints.ai_family=AF_UNSPEC;
+		hints.ai_socktype=SOCK_STREAM;
+		hints.ai_flags=(server?AI_PASSIVE:0);
+		if(getaddrinfo((host[0]==0?NULL:host),port,&hints,&res)!=0)
 			{
-			NodeMut(cfg,&(g->nodes[i]));
+			free(host);
+			errno=EINVAL;
+			return -1;
 			}
+		fd=-1;
+		for(ai=res;ai!=NULL;ai=ai->ai_next)
+			{
+			fd=socket(ai->ai_family,ai->ai_socktype,ai->ai_protocol);
+			if(fd==-1) continue;
+			setsockopt(fd,IPPROTO_TCP,TCP_NODELAY,&one,sizeof(int));
+			if(server)
+				{
+				setsockopt(fd,SOL_SOCKET,SO_REUSEADDR,&one,sizeof(int));
+				if(bind(fd,ai->ai_addr,ai->ai_addrlen)==0 && listen(fd,SOMAXCONN)==0) break;
+				}
+			else if(connect(fd,ai->ai_addr,ai->ai_addrlen)==0)
+				{
+				break;
+				}
+			close(fd);
+			fd=-1;
+			}
+		freeaddrinfo(res);
+		free(host);
+		return fd;
 		}
 	}
 
-static GenomePtr GenomeXCross(
-	ConfigPtr cfg,
-	GenomePtr p1,
-	GenomePtr p2
-	)
+/** connects to the coordinator, retrying while it is not listening yet */
+static RemotePtr RemoteConnect(const char* address)
 	{
-	GenomePtr g = GenomeNew1(cfg);
-	size_t xcross1;
-	size_t xcross2;
-	
-	if(RANDOM_FLOAT(cfg)<0.1)
+	int fd;
+	int tries;
+	uint32_t type=0;
+	size_t length=0UL;
+	uint32_t* hello;
+	RemotePtr remote;
+	for(tries=0;(fd=SocketOpen(address,0))==-1;++tries)
 		{
-		xcross1 = RANDOM_SIZE_T(cfg,GenomeSize(p1));
-		xcross2 = RANDOM_SIZE_T(cfg,GenomeSize(p2));
+		if(tries==100)
+			{
+			fprintf(stderr,"Cannot connect to %s %s\n",address,strerror(errno));
+			exit(EXIT_FAILURE);
+			}
+		usleep(100000);
 		}
-	else
+	hello=(uint32_t*)MessageRecv(fd,&type,&length);
+	if(hello==NULL || type!=MESSAGE_HELLO || length!=2*sizeof(uint32_t))
 		{
-		xcross1 = RANDOM_SIZE_T(cfg, MIN( GenomeSize(p1), GenomeSize(p2) ));
-		xcross2 = xcross1;
+		fprintf(stderr,"Bad handshake with %s\n",address);
+		exit(EXIT_FAILURE);
 		}
-	
-	
-	g->node_count=  xcross1 + (GenomeSize(p2)-xcross2);
-	
-	
-	g->nodes = (NodePtr)calloc(g->node_count,sizeof(Node));
-	if(g->nodes==NULL) THROW_ERROR("boum");
-	memcpy((void*)g->nodes,(void*)p1->nodes,xcross1*sizeof(Node));
-	memcpy((void*)&g->nodes[xcross1],(void*)&(p2->nodes[xcross2]),(GenomeSize(p2)-xcross2)*sizeof(Node));
-	
-	GenomeMute(g);
-	return g;
+	remote=(RemotePtr)calloc(1,sizeof(Remote));
+	if(remote==NULL) THROW_ERROR("boum");
+	remote->fd = fd;
+	remote->index = hello[0];
+	free(hello);
+	return remote;
 	}
 
-
-static void GenomeToDot(const GenomePtr g,size_t* parent_index,size_t* nodeIndex,FILE* out)
+/** like IslandMigrate, through the coordinator. Also receives MESSAGE_DONE */
+static void RemoteMigrate(ConfigPtr config,GenerationPtr gen)
 	{
-	size_t save_index=(*nodeIndex);
-	NodePtr node;
-	if(*nodeIndex>=GenomeSize(g)) return;
-	node = GenomeAt(g, *nodeIndex );
-	fprintf(out,"n%d[label=",*nodeIndex);
-	switch(node->type)
+	size_t i,length;
+	uint32_t type;
+	void* payload;
+	GenomePtr g;
+	struct pollfd pfd;
+	RemotePtr remote=config->remote;
+	if(remote->done) return;
+	if(config->curr_generations>0L && config->curr_generations % config->migration_interval == 0L)
 		{
-		case CONSTANT:
+		for(i=0;i< config->migration_size && i< GenerationCount(gen);++i)
 			{
-			fprintf(out,"\"%f\"];\n", node->core.constant);
-			break;
+			payload = GenomeSerialize(GenerationAt(gen,i),&length);
+			if(!MessageSend(remote->fd,MESSAGE_MIGRANT,payload,length)) remote->done=1;
+			free(payload);
 			}
-		case COLUMN:
+		}
+	while(!remote->done)
+		{
+		pfd.fd = remote->fd;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		if(poll(&pfd,1,0)<=0) break;
+		payload = MessageRecv(remote->fd,&type,&length);
+		if(payload==NULL)
 			{
-			fprintf(out,"\"${%d}\"];\n", node->core.column + 1);
+			remote->done=1;
 			break;
 			}
-		case OPERATOR:
+		if(type==MESSAGE_DONE)
 			{
-			
-			size_t i;
-			OperatorPtr op = OperatorListAt(g->config->operators, node->core.operator);
-			fprintf(out,"\"%s\"];\n", op->name);
-			
-			for(i=0;i< op->num_children;++i)
-				{
-				*nodeIndex=*nodeIndex + 1;
-				GenomeToDot(g,&save_index,nodeIndex,out);
-				}
-			break;
+			remote->done=1;
 			}
-		default:break;
-		}
-
-	if(parent_index!=NULL)
-		{
-		fprintf(out,"n%d -> n%d ;\n",save_index,*parent_index);
+		else if(type==MESSAGE_MIGRANT && (g=GenomeDeserialize(config,payload,length))!=NULL)
+			{
+			GenerationAdd(gen,g);
+			}
+		free(payload);
 		}
 	}
 
-#define SAFE_FOPEN(ext) strcpy(fname,g->config->output_filename); \
-	strcat(fname,ext);\
-	out=fopen(fname,"w");\
-	if(out==NULL) { fprintf(stderr,"Cannot open \"%s\". (%s)\n",fname,strerror(errno)); exit(EXIT_FAILURE);}
-	
-void GenomeSave(const GenomePtr g)
+/**
+ * called when a better genome was found. Prints and saves it. With islands, it
+ * is only kept for IslandReport. A worker process sends it to the coordinator.
+ * returns 1 if the evolution must stop.
+ */
+static boolean_t EvolveBest(ConfigPtr config,GenomePtr best)
 	{
-	size_t index=0UL,rowIndex;
-	FILE* out=NULL;
-	char* fname=NULL;
-	if(g->config->output_filename==NULL) return;
-	fname=(char*)calloc(strlen(g->config->output_filename)+20,sizeof(char));
-	SAFE_FOPEN(".dot");
-	fputs("digraph {\n",out);
-	GenomeToDot(g,NULL,&index,out);
-	fputs("}\n",out);
-	fflush(out);
-	fclose(out);
-	
-	SAFE_FOPEN(".tsv");
-	for(rowIndex=0;
-		rowIndex< SpreadSheetRows(g->config->spreadsheet);
-		++rowIndex)
+	IslandPtr island;
+	IslandImprovementPtr improvement;
+	if(config->remote!=NULL)
 		{
-		size_t i;
-		size_t nodeIndex=0;
-		floating_t  value=0.0;
-		boolean_t  error=0;
-		for(i=0;i< SpreadSheetColumns(g->config->spreadsheet);++i)
-			{
-			fprintf(out,"%E\t",SpreadSheetAt(g->config->spreadsheet,rowIndex,i));
-			}
-		GenomeEval1(g,rowIndex,&nodeIndex,&value,&error);
-		if(error)
+		size_t length;
+		void* payload = GenomeSerialize(best,&length);
+		if(!MessageSend(config->remote->fd,MESSAGE_BEST,payload,length)) config->remote->done=1;
+		free(payload);
+		return config->remote->done;
+		}
+	if(config->island==NULL)
+		{
+		config->best_fitness = best->fitness;
+		if(!config->quiet) GenomePrint(best,stdout);
+		if(config->writer!=NULL)
 			{
-			fputs("NA",out);
+			ResultWriterSubmit(config->writer,best);
 			}
-		else
+		if(best->fitness < config->min_fitness)
 			{
-			fprintf(out,"%E",value);
+			fprintf(stderr,"min fitness reached\n");
+			return 1;
 			}
-		fputs("\n",out);
+		return 0;
 		}
-	fflush(out);
-	fclose(out);
-
-	SAFE_FOPEN(".R");
-	fprintf(out,"T<-read.table(\"%s.tsv\",header=F,sep=\"\t\")\n",g->config->output_filename);
-	fputs("T<-T[order(T[,ncol(T)-1]),]\n",out);
-	fprintf(out,"jpeg(\"%s.plot1.jpeg\")\n",g->config->output_filename);
-	fputs("plot(T[,ncol(T)-1],col=\"red\")\n",out);
-	fputs("points(T[,ncol(T)],col=\"green\")\n",out);
-	fputs("dev.off()\n",out);
-	fflush(out);
-	fclose(out);
-	
-	SAFE_FOPEN(".mk");
-	fprintf(out,".PHONY=all\nOUTPUT=%s\n",g->config->output_filename);
-	fprintf(out,"all:${OUTPUT}.png ${OUTPUT}.plot1.jpeg\n");
-	fprintf(out,"${OUTPUT}.png: ${OUTPUT}.dot\n\tdot -Tpng -o$@ $<\n");
-	fprintf(out,"${OUTPUT}.plot1.jpeg: ${OUTPUT}.R ${OUTPUT}.tsv\n\tR --no-save < $<\n");
-	fflush(out);
-	fclose(out);
+	/* compared with the other islands by IslandReport */
+	improvement = (IslandImprovementPtr)calloc(1,sizeof(IslandImprovement));
+	if(improvement==NULL) THROW_ERROR("boum");
+	improvement->generation = config->curr_generations;
+	improvement->genome = GenomeClone(best);
+	island = config->island;
+	pthread_mutex_lock(&(island->shared->lock));
+	if(island->last_improvement==NULL) island->improvements = improvement;
+	else island->last_improvement->next = improvement;
+	island->last_improvement = improvement;
+	pthread_mutex_unlock(&(island->shared->lock));
+	return 0;
+	}
 
-	free(fname);
+/** true if another island reached the min fitness */
+static boolean_t EvolveDone(ConfigPtr config)
+	{
+	IslandsPtr shared;
+	boolean_t done;
+	if(config->remote!=NULL) return config->remote->done;
+	if(config->island==NULL) return 0;
+	shared = config->island->shared;
+	pthread_mutex_lock(&shared->lock);
+	done = shared->done;
+	pthread_mutex_unlock(&shared->lock);
+	return done;
 	}
 
-static void doWork(ConfigPtr config)
+/** evolution of one population */
+static void Evolve(ConfigPtr config)
 	{
 	GenerationPtr gen=NULL;
 	config->curr_generations=0L;
 	GenomePtr best=NULL;
-	/* create initial family */
-	gen = GenerationNew(config);
+	SelectionPtr selection=NULL;
+	size_t i;
+	/* index of the arena holding the survivors of the current generation */
+	size_t curr_arena=0UL;
+	config->nurseries = (ArenaPtr*)calloc(config->num_threads,sizeof(ArenaPtr));
+	if(config->nurseries==NULL) THROW_ERROR("boum");
+	for(i=0;i< config->num_threads;++i) config->nurseries[i] = ArenaNew();
+	config->generation_arenas[0] = ArenaNew();
+	config->generation_arenas[1] = ArenaNew();
+	selection = SelectionNew(config->steady_state ?
+		config->max_genomes_per_generation:
+		config->min_genomes_per_generation
+		);
+	if(config->num_threads>1)
+		{
+		config->thread_pool = ThreadPoolNew(config->num_threads);
+		}
+	if(config->resume_filename!=NULL)
+		{
+		gen = CheckpointRestore(config,config->resume_filename,config->generation_arenas[curr_arena],&best);
+		}
+	else
+		{
+		/* create initial family */
+		gen = GenerationNew(config);
+		}
 	
-	while( config->max_generations==-1L || config->curr_generations < config->max_generations )
+	while( (config->max_generations==-1L || config->curr_generations < config->max_generations) &&
+		!EvolveDone(config))
 		{
-		size_t i,j;
 		GenerationPtr gen1= GenerationNew1(config);
 		GenerationPtr tmp = NULL;
+		size_t n_children;
 		
 		while( GenerationCount(gen) < config->max_genomes_per_generation )
 			{
@@ -987,79 +5484,93 @@ static void doWork(ConfigPtr config)
 			{
 			GenomePtr copy=GenomeClone(best);
 			GenomeMute(copy);
+			copy->fitness = NAN;
+			copy->bad_flag = 0;
 			GenerationAdd(gen,copy);
 			}
 		
-		for(i=0 ; i < GenerationCount(gen) ; ++i)
+		/* number of children */
+		n_children = (config->steady_state ?
+			config->offspring_count :
+			GenerationCount(gen)*GenerationCount(gen)
+			);
+		
+		if(config->steady_state)
 			{
-			GenomePtr gi=GenerationAt(gen,i);
-			for(j=0 ; j < GenerationCount(gen) ; ++j)
+			/* the parents are chosen on their fitness */
+			if(config->stream_block_rows>0UL)
 				{
-				GenomePtr newgen=NULL;
-				GenomePtr gj=GenerationAt(gen,j);
-				if( i == j && !config->enable_self_self) continue;
-				
-				newgen =  GenomeXCross(config,gi,gj);
-				
-				if(newgen==NULL ||
-					GenomeSize(newgen)==0 ||
-					GenomeSize(newgen) < config->min_base_per_genome ||
-					GenomeSize(newgen) > config->max_base_per_genome ||
-					(config->remove_clone && (GenomeEquals(newgen,gi) || GenomeEquals(newgen,gj)) )
-					)
-					{
-					GenomeFree(newgen);
-					continue;
-					}
-				GenomeEval(newgen);
-				if( newgen->bad_flag )
-					{
-					GenomeFree(newgen);
-					continue;
-					}
-				newgen->generation = config->curr_generations;
-				
-				gen1->genomes = (Genome**)realloc(gen1->genomes,(gen1->genome_count+1)*sizeof(Genome*));
-				if(gen1->genomes==NULL) THROW_ERROR("boum");
-				gen1->genomes[ gen1->genome_count ] = newgen ;
-				gen1->genome_count++;
+				GenerationEvalStreaming(config,gen);
+				}
+			else if(config->thread_pool!=NULL)
+				{
+				ThreadPoolRun(config->thread_pool,GenerationCount(gen),EvalTask,gen);
+				}
+			else
+				{
+				for(i=0;i< GenerationCount(gen);++i) EvalTask(gen,i);
 				}
 			}
-
-		
-		/* sort on fitness */
-		qsort(	(void*)gen1->genomes,
-			gen1->genome_count,
-			sizeof(GenomePtr),
-			_GenomeCompare
-			);	
 		
-		/* remove duplicate children */
-		i=0;
-		while(i+1< GenerationCount(gen1))
+		/* rand_r keeps its former sequential sequence when there is no thread */
+		if(config->thread_pool!=NULL || config->random.kind!=RANDOM_RAND_R)
 			{
-			if( GenomeEquals(GenerationAt(gen1,i),GenerationAt(gen1,i+1) ))
+			OffspringContext ctx;
+			size_t n = n_children;
+			ctx.config = config;
+			ctx.gen = gen;
+			RandomInit(&(ctx.random),config->random.kind,RandomNext(&(config->random)));
+			ctx.children = NULL;
+			ctx.selection = selection;
+			if(OffspringDeferred(config))
 				{
-				GenomeFree( GenerationAt(gen1,i) );
-				memmove(
-					(void*)&gen1->genomes[i],
-					(const void*)&gen1->genomes[i+1],
-					sizeof(GenomePtr)*(GenerationCount(gen1)-(i+1))
-					);
-				gen1->genome_count--;
+				ctx.children = (GenomePtr*)calloc(n,sizeof(GenomePtr));
+				if(ctx.children==NULL) THROW_ERROR("boum");
+				}
+			if(config->thread_pool!=NULL)
+				{
+				ThreadPoolRun(config->thread_pool,n,OffspringTask,&ctx);
 				}
 			else
 				{
-				++i;
+				for(i=0;i< n;++i) OffspringTask(&ctx,i);
+				}
+			if(ctx.children!=NULL)
+				{
+				/* children are collected in the same order as the sequential loop */
+				for(i=0;i< n;++i)
+					{
+					if(ctx.children[i]==NULL) continue;
+					GenerationAdd(gen1,ctx.children[i]);
+					}
+				free(ctx.children);
+				}
+			}
+		else
+			{
+			size_t n = n_children;
+			thread_arena = config->nurseries[0];
+			for(i=0 ; i < n ; ++i)
+				{
+				GenomePtr newgen = GenerationOffspring(config,gen,i,selection);
+				if(newgen==NULL) continue;
+				GenerationAdd(gen1,newgen);
 				}
+			thread_arena = NULL;
 			}
-				
-		while( GenerationCount(gen1) > config->min_genomes_per_generation )
+		
+		if(OffspringDeferred(config))
+			{
+			GenerationPromote(config,gen1,selection,(config->steady_state?GenerationCount(gen):0UL));
+			}
+		
+		if(config->steady_state)
 			{
-			GenomeFree( gen1->genomes[ GenerationCount(gen1) -1 ] );
-			gen1->genome_count--;
+			GenerationSteadyState(gen,selection);
 			}
 		
+		/* the best distinct children, sorted on fitness */
+		SelectionToGeneration(selection,gen1);
 		
 		if(config->massive_extinction_every!=-1L &&
 			config->curr_generations > 1 &&
@@ -1081,39 +5592,672 @@ static void doWork(ConfigPtr config)
 		
 		if(GenerationCount(gen1)>0 && !(GenerationAt(gen1,0)->bad_flag) )
 			{
-			//GenomePrint(GenerationAt(gen1,0),stderr);
-			if(best==NULL || best->fitness > GenerationAt(gen1,0)->fitness)
+			//GenomePrint(GenerationAt(gen1,0),stderr);
+			if(best==NULL || best->fitness > GenerationAt(gen1,0)->fitness)
+				{
+				GenomeFree(best);
+				best=GenomeClone( GenerationAt(gen1,0) );
+				
+				if(EvolveBest(config,best)) break;
+				}
+			}
+		else
+			{
+			fprintf(stderr,"too many errors\n");
+			}
+		if(config->island!=NULL)
+			{
+			if(IslandReport(config->island))
+				{
+				GenerationFree(gen1);
+				break;
+				}
+			IslandMigrate(config->island,gen1);
+			}
+		else if(config->remote!=NULL)
+			{
+			RemoteMigrate(config,gen1);
+			}
+		/* the survivors are compacted in the other arena, the children and the previous generation are released */
+		for(i=0;i< GenerationCount(gen1);++i)
+			{
+			gen1->genomes[i] = GenomeMoveTo(gen1->genomes[i],config->generation_arenas[1-curr_arena]);
+			}
+		for(i=0;i< config->num_threads;++i) ArenaClear(config->nurseries[i]);
+		tmp = gen;
+		gen = gen1;
+		GenerationFree(tmp);
+		ArenaClear(config->generation_arenas[curr_arena]);
+		curr_arena = 1-curr_arena;
+		config->curr_generations++;
+		if(config->checkpoint_filename!=NULL &&
+			(config->curr_generations % config->checkpoint_interval==0 ||
+			 config->curr_generations==config->max_generations))
+			{
+			size_t length;
+			void* buf = CheckpointSerialize(config,gen,best,&length);
+			ResultWriterCheckpoint(config->writer,buf,length);
+			}
+		}
+	GenerationFree(gen);
+	for(i=0;i< config->num_threads;++i) ArenaFree(config->nurseries[i]);
+	free(config->nurseries);
+	config->nurseries=NULL;
+	ArenaFree(config->generation_arenas[0]);
+	ArenaFree(config->generation_arenas[1]);
+	config->generation_arenas[0]=NULL;
+	config->generation_arenas[1]=NULL;
+	GenomeFree(best);
+	SelectionFree(selection);
+	ThreadPoolFree(config->thread_pool);
+	config->thread_pool=NULL;
+	}
+
+static void* IslandMain(void* arg)
+	{
+	IslandPtr island=(IslandPtr)arg;
+	Evolve(&(island->config));
+	return NULL;
+	}
+
+/** runs config->num_islands islands in parallel, see Island */
+static void IslandsRun(ConfigPtr config)
+	{
+	size_t i;
+	MigrationBatchPtr batch;
+	Islands shared;
+	IslandPtr islands=(IslandPtr)calloc(config->num_islands,sizeof(Island));
+	if(islands==NULL) THROW_ERROR("boum");
+	memset((void*)&shared,0,sizeof(Islands));
+	pthread_mutex_init(&shared.lock,NULL);
+	shared.islands = islands;
+	shared.num_islands = config->num_islands;
+	for(i=0;i< config->num_islands;++i)
+		{
+		IslandPtr island=&islands[i];
+		island->index = i;
+		memcpy((void*)&(island->config),(void*)config,sizeof(Config));
+		RandomStream(&(island->config.random),&(config->random),i);
+		island->config.island = island;
+		island->next = &islands[(i+1)%config->num_islands];
+		island->shared = &shared;
+		island->reported = -1L;
+		}
+	for(i=0;i< config->num_islands;++i)
+		{
+		if(pthread_create(&islands[i].thread,NULL,IslandMain,&islands[i])!=0) THROW_ERROR("Cannot create thread");
+		}
+	for(i=0;i< config->num_islands;++i)
+		{
+		pthread_join(islands[i].thread,NULL);
+		}
+	for(i=0;i< config->num_islands;++i)
+		{
+		IslandImprovementPtr m;
+		/* migrants never received */
+		while((batch=MigrationRingPop(&(islands[i].inbox)))!=NULL) MigrationBatchFree(batch);
+		/* better genomes never compared, when the evolution was stopped */
+		while((m=islands[i].improvements)!=NULL)
+			{
+			islands[i].improvements = m->next;
+			GenomeFree(m->genome);
+			free(m);
+			}
+		GenomeFree(islands[i].current);
+		}
+	GenomeFree(shared.best);
+	pthread_mutex_destroy(&shared.lock);
+	free(islands);
+	}
+
+/** connection of the coordinator to a worker */
+typedef struct worker_link_t
+	{
+	/* -1 once closed */
+	int fd;
+	/* bytes waiting to be sent */
+	char* out;
+	size_t out_length;
+	size_t out_capacity;
+	/* bytes received, not yet a complete message */
+	char* in;
+	size_t in_length;
+	size_t in_capacity;
+	} WorkerLink,*WorkerLinkPtr;
+
+/* a migrant is dropped when that many bytes are waiting for a worker */
+#define WORKER_LINK_MAX_PENDING (16UL*1024UL*1024UL)
+
+static void WorkerLinkQueue(WorkerLinkPtr w,uint32_t type,const void* payload,size_t length,boolean_t droppable)
+	{
+	MessageHeader h;
+	size_t n = sizeof(MessageHeader)+length;
+	if(w->fd==-1) return;
+	if(droppable && w->out_length+n > WORKER_LINK_MAX_PENDING) return;
+	if(w->out_length+n > w->out_capacity)
+		{
+		w->out_capacity = MAX(w->out_length+n,2*w->out_capacity);
+		w->out = (char*)realloc(w->out,w->out_capacity);
+		if(w->out==NULL) THROW_ERROR("boum");
+		}
+	h.type = type;
+	h.length = (uint32_t)length;
+	memcpy(&(w->out[w->out_length]),&h,sizeof(MessageHeader));
+	if(length>0UL) memcpy(&(w->out[w->out_length+sizeof(MessageHeader)]),payload,length);
+	w->out_length+=n;
+	}
+
+static void WorkerLinkClose(WorkerLinkPtr w)
+	{
+	if(w->fd!=-1) close(w->fd);
+	w->fd=-1;
+	w->out_length=0UL;
+	w->in_length=0UL;
+	}
+
+/** sends what can be sent without blocking */
+static void WorkerLinkFlush(WorkerLinkPtr w)
+	{
+	while(w->fd!=-1 && w->out_length>0UL)
+		{
+		ssize_t n=send(w->fd,w->out,w->out_length,MSG_DONTWAIT|MSG_NOSIGNAL);
+		if(n<0)
+			{
+			if(errno==EINTR) continue;
+			if(errno!=EAGAIN && errno!=EWOULDBLOCK) WorkerLinkClose(w);
+			break;
+			}
+		memmove(w->out,&(w->out[n]),w->out_length-(size_t)n);
+		w->out_length-=(size_t)n;
+		}
+	}
+
+/** reads what can be read without blocking. returns 0 if the connection was closed */
+static boolean_t WorkerLinkReceive(WorkerLinkPtr w)
+	{
+	ssize_t n;
+	if(w->in_capacity - w->in_length < 65536UL)
+		{
+		w->in_capacity = MAX(w->in_length+65536UL,2*w->in_capacity);
+		w->in = (char*)realloc(w->in,w->in_capacity);
+		if(w->in==NULL) THROW_ERROR("boum");
+		}
+	/* a single read: poll() tells again if more bytes are waiting */
+	do	{
+		n=recv(w->fd,&(w->in[w->in_length]),w->in_capacity-w->in_length,MSG_DONTWAIT);
+		} while(n<0 && errno==EINTR);
+	if(n>0)
+		{
+		w->in_length+=(size_t)n;
+		return 1;
+		}
+	return n<0 && (errno==EAGAIN || errno==EWOULDBLOCK);
+	}
+
+/** returns the payload of the next complete message received, or NULL. See MessageRecv */
+static void* WorkerLinkNext(WorkerLinkPtr w,uint32_t* type,size_t* length)
+	{
+	MessageHeader h;
+	char* payload;
+	size_t n;
+	if(w->fd==-1 || w->in_length < sizeof(MessageHeader)) return NULL;
+	memcpy(&h,w->in,sizeof(MessageHeader));
+	if(h.length > MESSAGE_MAX_LENGTH)
+		{
+		WorkerLinkClose(w);
+		return NULL;
+		}
+	n = sizeof(MessageHeader)+h.length;
+	if(w->in_length < n) return NULL;
+	payload=(char*)malloc(h.length+1U);
+	if(payload==NULL) THROW_ERROR("boum");
+	memcpy(payload,&(w->in[sizeof(MessageHeader)]),h.length);
+	memmove(w->in,&(w->in[n]),w->in_length-n);
+	w->in_length-=n;
+	*type = h.type;
+	*length = h.length;
+	return payload;
+	}
+
+/**
+ * the coordinator of config->num_workers worker processes, see Remote. It never
+ * blocks on a worker: the messages are read and sent without blocking, through
+ * the buffers of WorkerLink, and only the complete messages are handled.
+ */
+static void Coordinate(ConfigPtr config)
+	{
+	size_t i,k;
+	size_t n=config->num_workers;
+	size_t running=n;
+	boolean_t done=0;
+	GenomePtr best=NULL;
+	WorkerLinkPtr workers;
+	struct pollfd* pfds;
+	int server=SocketOpen(config->coordinator_address,1);
+	if(server==-1)
+		{
+		fprintf(stderr,"Cannot listen on %s %s\n",config->coordinator_address,strerror(errno));
+		exit(EXIT_FAILURE);
+		}
+	workers=(WorkerLinkPtr)calloc(n,sizeof(WorkerLink));
+	pfds=(struct pollfd*)calloc(n,sizeof(struct pollfd));
+	if(workers==NULL || pfds==NULL) THROW_ERROR("boum");
+	for(i=0;i< n;++i)
+		{
+		int one=1;
+		uint32_t hello[2];
+		while((workers[i].fd=accept(server,NULL,NULL))==-1)
+			{
+			if(errno==EINTR) continue;
+			fprintf(stderr,"Cannot accept %s\n",strerror(errno));
+			exit(EXIT_FAILURE);
+			}
+		setsockopt(workers[i].fd,IPPROTO_TCP,TCP_NODELAY,&one,sizeof(int));
+		hello[0]=(uint32_t)i;
+		hello[1]=(uint32_t)n;
+		WorkerLinkQueue(&workers[i],MESSAGE_HELLO,hello,sizeof(hello),0);
+		WorkerLinkFlush(&workers[i]);
+		}
+	close(server);
+	while(running>0UL)
+		{
+		for(i=0;i< n;++i)
+			{
+			pfds[i].fd = workers[i].fd;
+			pfds[i].events = POLLIN|(workers[i].out_length>0UL?POLLOUT:0);
+			pfds[i].revents = 0;
+			}
+		if(poll(pfds,n,-1)<0)
+			{
+			if(errno==EINTR) continue;
+			THROW_ERROR("poll failed");
+			}
+		for(i=0;i< n;++i)
+			{
+			uint32_t type=0;
+			size_t length=0UL;
+			void* payload;
+			boolean_t connected;
+			if(workers[i].fd==-1) continue;
+			if(pfds[i].revents & POLLOUT) WorkerLinkFlush(&workers[i]);
+			if(workers[i].fd==-1 || (pfds[i].revents & (POLLIN|POLLHUP|POLLERR))==0) continue;
+			connected = WorkerLinkReceive(&workers[i]);
+			while((payload=WorkerLinkNext(&workers[i],&type,&length))!=NULL)
 				{
-				GenomeFree(best);
-				best=GenomeClone( GenerationAt(gen1,0) );
-				
-				GenomePrint(best,stdout);
-				if(config->output_filename!=NULL)
+				if(type==MESSAGE_BYE)
 					{
-					GenomeSave(best);
+					WorkerLinkClose(&workers[i]);
 					}
-				if(best->fitness < config->min_fitness)
+				else if(type==MESSAGE_MIGRANT)
 					{
-					fprintf(stderr,"min fitness reached\n");
-					break;
+					/* next worker still running */
+					for(k=(i+1)%n;k!=i && workers[k].fd==-1;k=(k+1)%n) {}
+					if(k!=i) WorkerLinkQueue(&workers[k],MESSAGE_MIGRANT,payload,length,1);
+					}
+				else if(type==MESSAGE_BEST && !done)
+					{
+					GenomePtr g = GenomeDeserialize(config,payload,length);
+					if(g!=NULL && (best==NULL || best->fitness > g->fitness))
+						{
+						GenomeFree(best);
+						best = g;
+						g = NULL;
+						fprintf(stdout,"ISLAND=%d\t",(int)i);
+						GenomePrint(best,stdout);
+						if(config->writer!=NULL)
+							{
+							ResultWriterSubmit(config->writer,best);
+							}
+						if(best->fitness < config->min_fitness)
+							{
+							fprintf(stderr,"min fitness reached\n");
+							done=1;
+							for(k=0;k< n;++k) WorkerLinkQueue(&workers[k],MESSAGE_DONE,NULL,0UL,0);
+							}
+						}
+					GenomeFree(g);
 					}
+				free(payload);
 				}
+			if(!connected) WorkerLinkClose(&workers[i]);
 			}
-		else
+		running=0UL;
+		for(i=0;i< n;++i)
 			{
-			fprintf(stderr,"too many errors\n");
+			WorkerLinkFlush(&workers[i]);
+			if(workers[i].fd!=-1) running++;
 			}
-		tmp = gen;
-		gen = gen1;
-		GenerationFree(tmp);
-		config->curr_generations++;
 		}
-	GenerationFree(gen);
+	if(strncmp(config->coordinator_address,"unix:",5)==0)
+		{
+		unlink(&(config->coordinator_address[5]));
+		}
+	for(i=0;i< n;++i)
+		{
+		free(workers[i].out);
+		free(workers[i].in);
+		}
+	free(workers);
+	free(pfds);
+	GenomeFree(best);
+	}
+
+static void doWork(ConfigPtr config)
+	{
+	if(config->output_filename!=NULL || config->checkpoint_filename!=NULL)
+		{
+		config->writer = ResultWriterNew(config);
+		}
+	if(config->coordinator_address!=NULL)
+		{
+		Coordinate(config);
+		ResultWriterFree(config->writer);
+		config->writer=NULL;
+		return;
+		}
+	if(config->fitness_cache_size>0UL)
+		{
+		config->fitness_cache = FitnessCacheNew(config->fitness_cache_size);
+		}
+	if(config->subtree_cache_mb>0UL)
+		{
+		config->subtree_cache = SubtreeCacheNew(config->subtree_cache_mb*1024UL*1024UL,SpreadSheetRows(config->spreadsheet));
+		}
+	if(config->sample_rows>0UL && config->sample_rows < SpreadSheetRows(config->spreadsheet))
+		{
+		config->sample = SpreadSheetSample(config->spreadsheet,config->sample_rows);
+		}
+	if(config->num_islands>1)
+		{
+		IslandsRun(config);
+		}
+	else if(config->connect_address!=NULL)
+		{
+		RemotePtr remote = RemoteConnect(config->connect_address);
+		config->remote = remote;
+		RandomStream(&(config->random),&(config->random),remote->index);
+		Evolve(config);
+		MessageSend(remote->fd,MESSAGE_BYE,NULL,0UL);
+		close(remote->fd);
+		free(remote);
+		config->remote=NULL;
+		}
+	else
+		{
+		Evolve(config);
+		}
+	if(config->fitness_cache!=NULL)
+		{
+		FitnessCachePtr c=config->fitness_cache;
+		fprintf(stderr,"#fitness cache: size=%lu hits=%lu misses=%lu evictions=%lu\n",
+			(unsigned long)c->size,c->hits,c->misses,c->evictions);
+		FitnessCacheFree(c);
+		config->fitness_cache=NULL;
+		}
+	if(config->subtree_cache!=NULL)
+		{
+		SubtreeCachePtr c=config->subtree_cache;
+		fprintf(stderr,"#subtree cache: bytes=%lu hits=%lu misses=%lu evictions=%lu\n",
+			(unsigned long)c->bytes,c->hits,c->misses,c->evictions);
+		SubtreeCacheFree(c);
+		config->subtree_cache=NULL;
+		}
+	SpreadSheetFree(config->sample);
+	config->sample=NULL;
+	ResultWriterFree(config->writer);
+	config->writer=NULL;
+	}
+
+/**
+ * Benchmark, see --bench. The same evolution (same options, same seed, fixed
+ * number of generations) runs on synthetic datasets of several sizes and the
+ * throughput of each workload is printed as JSON, one workload per line. With
+ * a baseline (a previous output), the speed of each workload is compared with
+ * the baseline and the best fitness must be the same.
+ */
+static const size_t bench_rows[]={1000UL,10000UL,100000UL};
+static const size_t bench_columns[]={4UL,16UL};
+static const int bench_bases[]={10,50};
+
+/** a synthetic dataset: uniform random columns, the target is the function of test.tsv (see the Makefile) */
+static SpreadSheetPtr BenchSheet(size_t rows,size_t columns,uint64_t seed)
+	{
+	size_t x,y;
+	Random r;
+	floating_t* cells;
+	SpreadSheetPtr p=(SpreadSheetPtr)calloc(1,sizeof(SpreadSheet));
+	if(p==NULL) THROW_ERROR("Out of memory");
+	p->columns = columns;
+	p->size = rows*columns;
+	p->columnar = (floating_t*)calloc(p->size,sizeof(floating_t));
+	if(p->columnar==NULL) THROW_ERROR("Out of memory");
+	cells = p->columnar;
+	RandomInit(&r,RANDOM_XOSHIRO,seed);
+	for(x=0;x+1< columns;++x)
+		{
+		for(y=0;y< rows;++y) cells[x*rows+y] = RandomFloat(&r);
+		}
+	for(y=0;y< rows;++y)
+		{
+		cells[(columns-1)*rows+y] = 2.0*((cells[y]-cells[rows+y])/(cells[y]+cells[2*rows+y]));
+		}
+	SpreadSheetNormalize(p);
+	return p;
+	}
+
+/** resets the peak resident size of the process (VmHWM), when the kernel allows it */
+static void BenchResetPeakRss(void)
+	{
+	FILE* f=fopen("/proc/self/clear_refs","w");
+	if(f==NULL) return;
+	fputs("5",f);
+	fclose(f);
 	}
 
+/** peak resident size of the process, in kB */
+static long BenchPeakRss(void)
+	{
+	char line[256];
+	long kb=-1L;
+	FILE* f=fopen("/proc/self/status","r");
+	if(f!=NULL)
+		{
+		while(fgets(line,sizeof(line),f)!=NULL)
+			{
+			if(strncmp(line,"VmHWM:",6)==0) kb=atol(&line[6]);
+			}
+		fclose(f);
+		}
+	if(kb<0L)
+		{
+		struct rusage usage;
+		getrusage(RUSAGE_SELF,&usage);
+		kb=usage.ru_maxrss;
+		}
+	return kb;
+	}
+
+/** reads the number 'key' in a line of a --bench output. returns 0 if it is missing */
+static boolean_t BenchJsonNumber(const char* line,const char* key,double* value)
+	{
+	char* end;
+	char pattern[64];
+	const char* p;
+	sprintf(pattern,"\"%s\":",key);
+	p=strstr(line,pattern);
+	if(p==NULL) return 0;
+	p+=strlen(pattern);
+	*value = strtod(p,&end);
+	return end!=p;
+	}
+
+/** reads the lines of the baseline 'filename', NULL-terminated */
+static char** BenchBaselineRead(const char* filename)
+	{
+	char** lines=NULL;
+	size_t n=0UL;
+	char* line=NULL;
+	size_t capacity=0UL;
+	FILE* in=fopen(filename,"r");
+	if(in==NULL)
+		{
+		fprintf(stderr,"Cannot open %s %s\n",filename,strerror(errno));
+		exit(EXIT_FAILURE);
+		}
+	for(;;)
+		{
+		boolean_t eof = (getline(&line,&capacity,in)==-1);
+		lines=(char**)realloc(lines,(n+1)*sizeof(char*));
+		if(lines==NULL) THROW_ERROR("boum");
+		if(eof) break;
+		lines[n]=strdup(line);
+		if(lines[n]==NULL) THROW_ERROR("boum");
+		n++;
+		}
+	lines[n]=NULL;
+	free(line);
+	fclose(in);
+	return lines;
+	}
+
+static void Bench(ConfigPtr config,uint64_t seed,const char* baseline_filename)
+	{
+	size_t i,j,k,w=0UL;
+	const size_t count = sizeof(bench_rows)/sizeof(bench_rows[0])*
+		sizeof(bench_columns)/sizeof(bench_columns[0])*
+		sizeof(bench_bases)/sizeof(bench_bases[0]);
+	char** baseline = (baseline_filename==NULL?NULL:BenchBaselineRead(baseline_filename));
+	printf("{\"version\":1,\"seed\":%llu,\"generations\":%ld,\"threads\":%d,\"rng\":\"%s\",\"jit\":%d,\"workloads\":[\n",
+		(unsigned long long)seed,
+		config->max_generations,
+		config->num_threads,
+		(config->random.kind==RANDOM_RAND_R?"rand_r":"xoshiro"),
+		config->use_jit
+		);
+	/* the first line of a baseline holds its settings */
+	if(baseline!=NULL && baseline[0]!=NULL)
+		{
+		double value;
+		if(!BenchJsonNumber(baseline[0],"seed",&value) || (uint64_t)value!=seed ||
+			!BenchJsonNumber(baseline[0],"generations",&value) || (long)value!=config->max_generations)
+			{
+			fprintf(stderr,"warning: %s was run with another seed or another number of generations\n",baseline_filename);
+			}
+		}
+	for(i=0;i< sizeof(bench_rows)/sizeof(bench_rows[0]);++i)
+	for(j=0;j< sizeof(bench_columns)/sizeof(bench_columns[0]);++j)
+	for(k=0;k< sizeof(bench_bases)/sizeof(bench_bases[0]);++k)
+		{
+		Config c;
+		char name[64];
+		char pattern[80];
+		char** line;
+		double start,seconds,value;
+		long rss;
+		memcpy((void*)&c,(void*)config,sizeof(Config));
+		sprintf(name,"rows%lu_columns%lu_bases%d",(unsigned long)bench_rows[i],(unsigned long)bench_columns[j],bench_bases[k]);
+		c.spreadsheet = BenchSheet(bench_rows[i],bench_columns[j],seed);
+		c.max_base_per_genome = bench_bases[k];
+		c.min_base_per_genome = MIN(c.min_base_per_genome,c.max_base_per_genome);
+		RandomInit(&(c.random),config->random.kind,seed);
+		c.best_fitness = NAN;
+		c.genome_evaluations = 0UL;
+		c.node_evaluations = 0UL;
+		BenchResetPeakRss();
+		start = ResultWriterNow();
+		doWork(&c);
+		seconds = ResultWriterNow()-start;
+		rss = BenchPeakRss();
+		printf("{\"name\":\"%s\",\"rows\":%lu,\"columns\":%lu,\"max_bases\":%d,\"seconds\":%.6f,"
+			"\"generations\":%ld,\"genomes\":%llu,\"node_evaluations\":%llu,"
+			"\"generations_per_sec\":%.3f,\"genomes_per_sec\":%.3f,\"node_evaluations_per_sec\":%.6E,"
+			"\"peak_rss_kb\":%ld,\"best_fitness\":",
+			name,
+			(unsigned long)bench_rows[i],
+			(unsigned long)bench_columns[j],
+			bench_bases[k],
+			seconds,
+			c.curr_generations,
+			(unsigned long long)c.genome_evaluations,
+			(unsigned long long)c.node_evaluations,
+			c.curr_generations/seconds,
+			c.genome_evaluations/seconds,
+			c.node_evaluations/seconds,
+			rss
+			);
+		/* JSON has no NaN */
+		if(isnan(c.best_fitness)) printf("null");
+		else printf("%.17g",c.best_fitness);
+		sprintf(pattern,"\"name\":\"%s\"",name);
+		for(line=baseline;line!=NULL && *line!=NULL;++line)
+			{
+			boolean_t same;
+			double speedup;
+			if(strstr(*line,pattern)==NULL || !BenchJsonNumber(*line,"node_evaluations_per_sec",&value)) continue;
+			speedup = (c.node_evaluations/seconds)/value;
+			same = (BenchJsonNumber(*line,"best_fitness",&value) ?
+				value==c.best_fitness :
+				isnan(c.best_fitness)
+				);
+			printf(",\"speedup\":%.3f,\"same_result\":%s",speedup,(same?"true":"false"));
+			fprintf(stderr,"%s\tspeedup=%.3f%s\n",name,speedup,(same?"":"\tRESULT DIFFERS"));
+			break;
+			}
+		printf("}%s\n",(++w< count?",":""));
+		fflush(stdout);
+		SpreadSheetFree(c.spreadsheet);
+		}
+	printf("]}\n");
+	if(baseline!=NULL)
+		{
+		char** line;
+		for(line=baseline;*line!=NULL;++line) free(*line);
+		free(baseline);
+		}
+	}
+
+/* long options without a short equivalent */
+enum	{
+	OPTION_JIT_MIN_ROWS=1000,
+	OPTION_JIT_CHECK,
+	OPTION_FITNESS_CACHE,
+	OPTION_SUBTREE_CACHE,
+	OPTION_SAMPLE_ROWS,
+	OPTION_SAMPLE_PROMOTION,
+	OPTION_OFFSPRING,
+	OPTION_TOURNAMENT_SIZE,
+	OPTION_ISLANDS,
+	OPTION_MIGRATION_INTERVAL,
+	OPTION_MIGRANTS,
+	OPTION_COORDINATOR,
+	OPTION_WORKERS,
+	OPTION_CONNECT,
+	OPTION_SHM,
+	OPTION_RNG,
+	OPTION_WRITE_CACHE,
+	OPTION_READ_CACHE,
+	OPTION_STREAM_BLOCK_ROWS,
+	OPTION_SAVE_INTERVAL,
+	OPTION_CHECKPOINT,
+	OPTION_CHECKPOINT_INTERVAL,
+	OPTION_RESUME,
+	OPTION_BENCH,
+	OPTION_BENCH_BASELINE
+	};
+
 int main(int argc,char** argv)
 	{
 	Config config;
+	/* random generator and its seed, see --rng and --random-seed */
+	enum randomKind rng=RANDOM_XOSHIRO;
+	uint64_t seed=(uint64_t)(unsigned int)time(NULL);
+	boolean_t seed_given=0;
+	/* dataset caches, see --write-cache and --read-cache */
+	const char* write_cache=NULL;
+	const char* read_cache=NULL;
+	/* see --bench and --bench-baseline */
+	boolean_t bench=0;
+	const char* bench_baseline=NULL;
 	memset((void*)&config,0,sizeof(Config));
 	config.max_generations = -1L;
 	config.min_genomes_per_generation=5;
@@ -1139,7 +6283,30 @@ int main(int argc,char** argv)
 	config.min_fitness = 1E-6;
 	config.startup=time(NULL);
 	config.operators = OperatorsListNew();
-	config.seedp=(int)time(NULL);
+	config.use_jit=0;
+	config.jit_min_rows=10000UL;
+	config.jit_check_rows=0UL;
+	config.num_threads=1;
+	config.thread_pool=NULL;
+	config.early_abort=1;
+	config.fitness_cache_size=16384UL;
+	config.fitness_cache=NULL;
+	config.subtree_cache_mb=0UL;
+	config.subtree_cache=NULL;
+	config.sample_rows=0UL;
+	config.sample_promotion=0.1f;
+	config.save_interval=1.0;
+	config.checkpoint_interval=10L;
+	config.sample=NULL;
+	config.simplify=1;
+	config.subtree_operators=0;
+	config.steady_state=0;
+	config.offspring_count=0UL;
+	config.tournament_size=4UL;
+	config.num_islands=1UL;
+	config.migration_interval=10L;
+	config.migration_size=1UL;
+	config.island=NULL;
 	srand(time(NULL));
 	
 	for(;;)
@@ -1161,6 +6328,29 @@ int main(int argc,char** argv)
 		       {"enable-remove-clone",  no_argument , &config.remove_clone , 1},
 		       {"genome-size-matters",  no_argument , &config.sort_on_genome_size , 1},
 		       {"normalize-data",  no_argument , &config.normalize_data , 1},
+		       {"disable-early-abort",  no_argument , &config.early_abort , 0},
+		       {"disable-simplify",  no_argument , &config.simplify , 0},
+		       {"subtree-operators",  no_argument , &config.subtree_operators , 1},
+		       {"steady-state",  no_argument , &config.steady_state , 1},
+		       {"offspring",    required_argument, 0, OPTION_OFFSPRING},
+		       {"tournament-size",    required_argument, 0, OPTION_TOURNAMENT_SIZE},
+		       {"islands",    required_argument, 0, OPTION_ISLANDS},
+		       {"migration-interval",    required_argument, 0, OPTION_MIGRATION_INTERVAL},
+		       {"migrants",    required_argument, 0, OPTION_MIGRANTS},
+		       {"coordinator",    required_argument, 0, OPTION_COORDINATOR},
+		       {"workers",    required_argument, 0, OPTION_WORKERS},
+		       {"connect",    required_argument, 0, OPTION_CONNECT},
+		       {"shm",    required_argument, 0, OPTION_SHM},
+		       {"rng",    required_argument, 0, OPTION_RNG},
+		       {"write-cache",    required_argument, 0, OPTION_WRITE_CACHE},
+		       {"read-cache",    required_argument, 0, OPTION_READ_CACHE},
+		       {"stream-block-rows",    required_argument, 0, OPTION_STREAM_BLOCK_ROWS},
+		       {"save-interval",    required_argument, 0, OPTION_SAVE_INTERVAL},
+		       {"checkpoint",    required_argument, 0, OPTION_CHECKPOINT},
+		       {"checkpoint-interval",    required_argument, 0, OPTION_CHECKPOINT_INTERVAL},
+		       {"resume",    required_argument, 0, OPTION_RESUME},
+		       {"bench",    no_argument, 0, OPTION_BENCH},
+		       {"bench-baseline",    required_argument, 0, OPTION_BENCH_BASELINE},
 		       {"generations",    required_argument, 0, 'g'},
 		       {"random-seed",    required_argument, 0, 's'},
 		       {"min-bases",    required_argument, 0, 'b'},
@@ -1168,11 +6358,19 @@ int main(int argc,char** argv)
 		       {"min-genomes",    required_argument, 0, 'n'},
 		       {"max-genomes",    required_argument, 0, 'N'},
 		       {"output",    required_argument, 0, 'o'},
+		       {"jit",  no_argument , &config.use_jit , 1},
+		       {"jit-min-rows",    required_argument, 0, OPTION_JIT_MIN_ROWS},
+		       {"jit-check",    required_argument, 0, OPTION_JIT_CHECK},
+		       {"threads",    required_argument, 0, 't'},
+		       {"fitness-cache",    required_argument, 0, OPTION_FITNESS_CACHE},
+		       {"subtree-cache",    required_argument, 0, OPTION_SUBTREE_CACHE},
+		       {"sample-rows",    required_argument, 0, OPTION_SAMPLE_ROWS},
+		       {"sample-promotion",    required_argument, 0, OPTION_SAMPLE_PROMOTION},
 		       {0, 0, 0, 0}
 		     };
 		 /* getopt_long stores the option index here. */
 		int option_index = 0;
-	     	int c = getopt_long (argc, argv, "g:s:b:B:n:N:o:",
+	     	int c = getopt_long (argc, argv, "g:s:b:B:n:N:o:t:",
 		                    long_options, &option_index);
 		if(c==-1) break;
 		switch(c)
@@ -1184,7 +6382,8 @@ int main(int argc,char** argv)
 				}
 			case 's':
 				{
-				config.seedp=atoi(optarg);
+				seed=strtoull(optarg,NULL,10);
+				seed_given=1;
 				break;
 				};
 			case 'g':
@@ -1212,12 +6411,156 @@ int main(int argc,char** argv)
 				config.max_genomes_per_generation=atoi(optarg);
 				break;
 				};
+			case 't':
+				{
+				config.num_threads=atoi(optarg);
+				break;
+				};
+			case OPTION_JIT_MIN_ROWS:
+				{
+				config.jit_min_rows=strtoul(optarg,NULL,10);
+				break;
+				};
+			case OPTION_JIT_CHECK:
+				{
+				config.jit_check_rows=strtoul(optarg,NULL,10);
+				break;
+				};
+			case OPTION_FITNESS_CACHE:
+				{
+				config.fitness_cache_size=strtoul(optarg,NULL,10);
+				break;
+				};
+			case OPTION_SUBTREE_CACHE:
+				{
+				config.subtree_cache_mb=strtoul(optarg,NULL,10);
+				break;
+				};
+			case OPTION_SAMPLE_ROWS:
+				{
+				config.sample_rows=strtoul(optarg,NULL,10);
+				break;
+				};
+			case OPTION_SAMPLE_PROMOTION:
+				{
+				config.sample_promotion=atof(optarg);
+				break;
+				};
+			case OPTION_OFFSPRING:
+				{
+				config.offspring_count=strtoul(optarg,NULL,10);
+				break;
+				};
+			case OPTION_TOURNAMENT_SIZE:
+				{
+				config.tournament_size=strtoul(optarg,NULL,10);
+				break;
+				};
+			case OPTION_ISLANDS:
+				{
+				config.num_islands=strtoul(optarg,NULL,10);
+				break;
+				};
+			case OPTION_MIGRATION_INTERVAL:
+				{
+				config.migration_interval=atol(optarg);
+				break;
+				};
+			case OPTION_MIGRANTS:
+				{
+				config.migration_size=strtoul(optarg,NULL,10);
+				break;
+				};
+			case OPTION_COORDINATOR:
+				{
+				config.coordinator_address=optarg;
+				break;
+				};
+			case OPTION_WORKERS:
+				{
+				config.num_workers=strtoul(optarg,NULL,10);
+				break;
+				};
+			case OPTION_CONNECT:
+				{
+				config.connect_address=optarg;
+				break;
+				};
+			case OPTION_SHM:
+				{
+				config.shm_name=optarg;
+				break;
+				};
+			case OPTION_WRITE_CACHE:
+				{
+				write_cache=optarg;
+				break;
+				};
+			case OPTION_READ_CACHE:
+				{
+				read_cache=optarg;
+				break;
+				};
+			case OPTION_SAVE_INTERVAL:
+				{
+				config.save_interval=atof(optarg);
+				break;
+				};
+			case OPTION_CHECKPOINT:
+				{
+				config.checkpoint_filename=optarg;
+				break;
+				};
+			case OPTION_CHECKPOINT_INTERVAL:
+				{
+				config.checkpoint_interval=atol(optarg);
+				break;
+				};
+			case OPTION_RESUME:
+				{
+				config.resume_filename=optarg;
+				break;
+				};
+			case OPTION_BENCH:
+				{
+				bench=1;
+				break;
+				};
+			case OPTION_BENCH_BASELINE:
+				{
+				bench_baseline=optarg;
+				break;
+				};
+			case OPTION_STREAM_BLOCK_ROWS:
+				{
+				config.stream_block_rows=strtoul(optarg,NULL,10);
+				break;
+				};
+			case OPTION_RNG:
+				{
+				if(strcmp(optarg,"xoshiro")==0)
+					{
+					rng=RANDOM_XOSHIRO;
+					}
+				else if(strcmp(optarg,"rand_r")==0)
+					{
+					rng=RANDOM_RAND_R;
+					}
+				else
+					{
+					fprintf(stderr,"Unknown random generator %s (xoshiro or rand_r)\n",optarg);
+					return EXIT_FAILURE;
+					}
+				break;
+				};
 			case 0: break;
 			case '?': break;
 			default: exit(EXIT_FAILURE); break;
 			}
 		}
 	
+	RandomInit(&(config.random),rng,seed);
+	
 	if( config.max_base_per_genome < config.min_base_per_genome)
 		{
 		fprintf(stderr," config.max_base_per_genome < config.min_base_per_genome\n");
@@ -1236,9 +6579,130 @@ int main(int argc,char** argv)
 		return EXIT_FAILURE;
 		}
 	
-	if(optind==argc)
+	if( config.num_threads<1)
+		{
+		fprintf(stderr," bad config.num_threads\n");
+		return EXIT_FAILURE;
+		}
+	
+	if( config.sample_promotion<=0 || config.sample_promotion>1)
+		{
+		fprintf(stderr," bad config.sample_promotion\n");
+		return EXIT_FAILURE;
+		}
+	
+	if( config.tournament_size<1)
+		{
+		fprintf(stderr," bad config.tournament_size\n");
+		return EXIT_FAILURE;
+		}
+	
+	if( config.num_islands<1 || config.migration_interval<1)
+		{
+		fprintf(stderr," bad config.num_islands or config.migration_interval\n");
+		return EXIT_FAILURE;
+		}
+	
+	if( config.coordinator_address!=NULL && (config.num_workers<1 || config.connect_address!=NULL))
+		{
+		fprintf(stderr," bad config.num_workers or both --coordinator and --connect\n");
+		return EXIT_FAILURE;
+		}
+	
+	if( config.connect_address!=NULL && config.num_islands>1)
+		{
+		fprintf(stderr," --connect cannot be used with --islands\n");
+		return EXIT_FAILURE;
+		}
+	
+	if( config.save_interval<0.0)
+		{
+		fprintf(stderr," bad config.save_interval\n");
+		return EXIT_FAILURE;
+		}
+	
+	if( config.checkpoint_interval<1)
+		{
+		fprintf(stderr," bad config.checkpoint_interval\n");
+		return EXIT_FAILURE;
+		}
+	
+	if( (config.checkpoint_filename!=NULL || config.resume_filename!=NULL) &&
+		(config.num_islands>1 || config.coordinator_address!=NULL || config.connect_address!=NULL))
+		{
+		fprintf(stderr," --checkpoint and --resume cannot be used with --islands, --coordinator or --connect\n");
+		return EXIT_FAILURE;
+		}
+	
+	if( config.stream_block_rows>0UL && config.subtree_cache_mb>0UL)
+		{
+		fprintf(stderr," --subtree-cache cannot be used with --stream-block-rows\n");
+		return EXIT_FAILURE;
+		}
+	
+	if( config.offspring_count==0UL)
+		{
+		config.offspring_count = config.max_genomes_per_generation;
+		}
+	
+#ifndef GENPROG_HAS_JIT
+	if( config.use_jit )
+		{
+		fprintf(stderr,"JIT is not available on this platform. Using the interpreter.\n");
+		config.use_jit=0;
+		}
+#endif
+	
+	if(bench)
+		{
+		if(optind!=argc || read_cache!=NULL || write_cache!=NULL || config.shm_name!=NULL ||
+			config.output_filename!=NULL || config.checkpoint_filename!=NULL || config.resume_filename!=NULL ||
+			config.num_islands>1 || config.coordinator_address!=NULL || config.connect_address!=NULL)
+			{
+			fprintf(stderr,"--bench generates its input: it cannot be used with an input file, the caches, --output, the checkpoints or the islands\n");
+			return EXIT_FAILURE;
+			}
+		if(!seed_given) seed=42UL;
+		if(config.max_generations==-1L) config.max_generations=10L;
+		config.quiet=1;
+		RandomInit(&(config.random),rng,seed);
+		Bench(&config,seed,bench_baseline);
+		return EXIT_SUCCESS;
+		}
+	
+	if(read_cache!=NULL)
+		{
+		if(optind!=argc || config.shm_name!=NULL || write_cache!=NULL)
+			{
+			fprintf(stderr,"--read-cache cannot be used with an input file, --shm or --write-cache\n");
+			return EXIT_FAILURE;
+			}
+		config.spreadsheet=SpreadSheetMapCache(read_cache);
+		}
+	else if(write_cache!=NULL)
+		{
+		FILE* in=stdin;
+		if(config.shm_name!=NULL)
+			{
+			fprintf(stderr,"--write-cache cannot be used with --shm\n");
+			return EXIT_FAILURE;
+			}
+		if(optind!=argc && (in=fopen(argv[optind],"r"))==NULL)
+			{
+			fprintf(stderr,"Cannot open %s %s\n",
+				argv[optind],
+				strerror(errno)
+				);
+			return EXIT_FAILURE;
+			}
+		/* the input is streamed to the cache, then the run reads the cache */
+		SpreadSheetConvertCache(in,write_cache,config.num_threads);
+		if(in!=stdin) fclose(in);
+		config.spreadsheet=SpreadSheetMapCache(write_cache);
+		}
+	else if(optind==argc)
 		{
-		config.spreadsheet=SpreadSheetRead(stdin);
+		config.spreadsheet=(config.shm_name==NULL?SpreadSheetRead(stdin,config.num_threads):SpreadSheetShared(config.shm_name,stdin,config.num_threads));
 		}
 	else
 		{
@@ -1251,7 +6715,7 @@ int main(int argc,char** argv)
 				);
 			return EXIT_FAILURE;
 			}
-		config.spreadsheet=SpreadSheetRead(in);
+		config.spreadsheet=(config.shm_name==NULL?SpreadSheetRead(in,config.num_threads):SpreadSheetShared(config.shm_name,in,config.num_threads));
 		fclose(in);
 		}
 	doWork(&config);
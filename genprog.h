@@ -33,12 +33,28 @@ SOFTWARE.
 #include <time.h>
 #include <assert.h>
 #include <getopt.h>
+#include <pthread.h>
+#include <stdint.h>
 
 typedef double floating_t;
 typedef int boolean_t;
 enum nodeType {CONSTANT,OPERATOR,COLUMN};
 
+/** random generators, see --rng */
+enum randomKind {RANDOM_XOSHIRO,RANDOM_RAND_R};
+
+/** state of a random generator */
+typedef struct random_t
+	{
+	/** xoshiro256** state, or the rand_r state in s[0] */
+	uint64_t s[4];
+	enum randomKind kind;
+	} Random,*RandomPtr;
+/** instructions of a compiled genome */
+enum opCode {OP_CONSTANT,OP_COLUMN,OP_ADD,OP_MINUS,OP_MUL,OP_DIV,OP_NEGATE,OP_INVERT,OP_SQRT};
+
 #define MIN(a,b) (a<b?a:b)
+#define MAX(a,b) (a>b?a:b)
 
 /** SpreadSheet */
 typedef struct spreadsheet_t
@@ -47,10 +63,12 @@ typedef struct spreadsheet_t
 	size_t columns;
 	/** number of cells */
 	size_t size;
-	/** all cells */
-	floating_t* data;
+	/** all cells, column-major: cell(y,x) is columnar[x*rows+y] */
+	floating_t* columnar;
 	/** normalized data for last column */
 	floating_t* normalized;
+	/** the cells are mapped from a file, see --read-cache */
+	boolean_t mapped;
 	}SpreadSheet,*SpreadSheetPtr;
 
 
@@ -62,8 +80,12 @@ typedef struct operator_t
 	char name[100];
 	size_t num_children;
 	floating_t (*eval)(floating_t* );
+	/** vectorized version of eval: dest[i]=eval(a[i],b[i]) for i in [0,n) */
+	void (*eval_array)(floating_t* dest,const floating_t* a,const floating_t* b,size_t n);
 	int weight;
 	size_t index;
+	/** instruction used when a genome is compiled */
+	enum opCode opcode;
 	} Operator,*OperatorPtr;
 
 
@@ -84,6 +106,10 @@ typedef struct operator_list_t
 
 
 
+struct thread_pool_t;
+struct fitness_cache_t;
+struct subtree_cache_t;
+
 /** Configuration */
 typedef struct config_t
 	{
@@ -95,7 +121,8 @@ typedef struct config_t
 	int max_genomes_per_generation;
 	int min_base_per_genome;
 	int max_base_per_genome;
-	unsigned int seedp;
+	/** random state of the main thread */
+	Random random;
 	int weight_constant;
 	int weight_op;
 	int weight_column;
@@ -112,28 +139,156 @@ typedef struct config_t
 	floating_t min_fitness;
 	time_t startup;
 	char* output_filename;
+	/** compile the genomes to native code */
+	boolean_t use_jit;
+	/** don't use the JIT if the spreadsheet has less rows */
+	size_t jit_min_rows;
+	/** if >0, compare the JIT with GenomeEval1 on this number of rows */
+	size_t jit_check_rows;
+	/** number of threads used to create and evaluate the children */
+	int num_threads;
+	/** workers, NULL if num_threads==1 */
+	struct thread_pool_t* thread_pool;
+	/** stop the evaluation of a child as soon as it cannot survive */
+	boolean_t early_abort;
+	/** fold the constants and remove the identities when compiling a genome */
+	boolean_t simplify;
+	/** crossover and mutation on whole subtrees: the genomes are always complete trees */
+	boolean_t subtree_operators;
+	/** steady-state engine: the parents are chosen by tournament and the children replace the worst genomes */
+	boolean_t steady_state;
+	/** steady-state engine: number of children per generation */
+	size_t offspring_count;
+	/** steady-state engine: number of genomes drawn for a tournament */
+	size_t tournament_size;
+	/** number of islands, see --islands */
+	size_t num_islands;
+	/** islands: number of generations between two migrations */
+	long migration_interval;
+	/** islands: number of genomes sent to the next island */
+	size_t migration_size;
+	/** out-of-core evaluation: number of rows of a block, 0 to disable. See --stream-block-rows */
+	size_t stream_block_rows;
+	/** minimal time between two writes of the output files, in seconds */
+	double save_interval;
+	/** writes the output files in the background, or NULL. See --output */
+	struct result_writer_t* writer;
+	/** file of the periodic checkpoints, or NULL. See --checkpoint */
+	char* checkpoint_filename;
+	/** number of generations between two checkpoints */
+	long checkpoint_interval;
+	/** checkpoint restored when the evolution starts, or NULL. See --resume */
+	char* resume_filename;
+	/** don't print the best genomes, see --bench */
+	boolean_t quiet;
+	/** fitness of the last best genome, without islands */
+	floating_t best_fitness;
+	/** number of genomes evaluated, updated atomically. See --bench */
+	uint64_t genome_evaluations;
+	/** number of instructions computed, summed over the rows, updated atomically */
+	uint64_t node_evaluations;
+	/** the island using this config, or NULL */
+	struct island_t* island;
+	/** name of the shared memory segment holding the dataset, see --shm */
+	char* shm_name;
+	/** address where the coordinator listens, see --coordinator */
+	char* coordinator_address;
+	/** number of worker processes expected by the coordinator */
+	size_t num_workers;
+	/** address of the coordinator, see --connect */
+	char* connect_address;
+	/** connection of a worker process to its coordinator, or NULL */
+	struct remote_t* remote;
+	/** arenas of the children being created, one per worker */
+	struct arena_t** nurseries;
+	/** arenas of the current and next generations */
+	struct arena_t* generation_arenas[2];
+	/** number of entries of the fitness cache, 0 to disable */
+	size_t fitness_cache_size;
+	/** fitness of the genomes already seen, or NULL */
+	struct fitness_cache_t* fitness_cache;
+	/** memory (Mb) of the subtree cache, 0 to disable */
+	size_t subtree_cache_mb;
+	/** output of the subtrees already seen, or NULL */
+	struct subtree_cache_t* subtree_cache;
+	/** staged evaluation: number of rows used to score the new children, 0 to disable */
+	size_t sample_rows;
+	/** staged evaluation: fraction of the children evaluated on all the rows */
+	float sample_promotion;
+	/** staged evaluation: the rows used to score the new children, or NULL */
+	struct spreadsheet_t* sample;
 	} Config,*ConfigPtr;
-	
-#define RANDOM_FLOAT(cfg) ((double)rand_r(&(cfg->seedp))/(double)RAND_MAX)
-#define RANDOM_SIZE_T(cfg,LEN)  (rand_r(&(cfg->seedp))% (LEN) )
 
-/** Node */
-typedef struct node_t
+void RandomInit(RandomPtr r,enum randomKind kind,uint64_t seed);
+void RandomStream(RandomPtr r,const RandomPtr parent,uint64_t index);
+uint64_t RandomNext(RandomPtr r);
+unsigned int RandomUInt(RandomPtr r);
+double RandomFloat(RandomPtr r);
+size_t RandomBelow(RandomPtr r,size_t n);
+RandomPtr RandomState(ConfigPtr cfg);
+#define RANDOM_FLOAT(cfg) RandomFloat(RandomState(cfg))
+#define RANDOM_SIZE_T(cfg,LEN)  RandomBelow(RandomState(cfg),(size_t)(LEN))
+
+/**
+ * Node, packed in 8 bytes. A constant is stored as is. An operator or a column
+ * is stored as a NaN (a constant is never NaN): the type is in bits 32-39 and
+ * the index in the 24 lowest bits. Use NodeType, NodeConstant... to read it.
+ */
+typedef union node_t
 	{
-	union
-		{
-		floating_t constant;
-		size_t column;
-		size_t operator;
-		} core;
-	enum nodeType type;
+	floating_t constant;
+	uint64_t bits;
 	} Node,*NodePtr;	
+
+enum nodeType NodeType(const NodePtr node);
+floating_t NodeConstant(const NodePtr node);
+size_t NodeColumn(const NodePtr node);
+size_t NodeOperator(const NodePtr node);
+void NodeSetConstant(NodePtr node,floating_t v);
+void NodeSetColumn(NodePtr node,size_t column);
+void NodeSetOperator(NodePtr node,size_t operator);
 	
 
 
 
 
 
+/**
+ * One instruction of a compiled genome
+ */
+typedef struct instruction_t
+	{
+	enum opCode opcode;
+	union
+		{
+		floating_t constant;
+		size_t column;
+		} arg;
+	} Instruction,*InstructionPtr;
+
+/**
+ * A genome lowered to a postfix stack program
+ */
+typedef struct program_t
+	{
+	/** instructions, in postfix order */
+	InstructionPtr instructions;
+	/** number of instructions */
+	size_t size;
+	/** max number of values on the stack */
+	size_t stack_depth;
+	/** number of nodes of the genome used by the program. Remaining nodes are introns */
+	size_t node_count;
+	/** false if the genome is not a complete tree */
+	boolean_t valid;
+	/** native code generated by the JIT, or NULL */
+	void* jit_code;
+	/** size of the mmap'd jit_code */
+	size_t jit_size;
+	/** constants used by jit_code */
+	floating_t* jit_constants;
+	} Program,*ProgramPtr;
+
 /**
  * A Genome
  */
@@ -153,6 +308,10 @@ typedef struct genome_t
 	long  generation;
 	/** creation date */
 	time_t creation;
+	/** compiled nodes, or NULL if not compiled yet. See GenomeCompile */
+	ProgramPtr program;
+	/** arena holding this genome and its nodes, or NULL if they were allocated with malloc */
+	struct arena_t* arena;
 	}Genome,*GenomePtr;
 
 /*
@@ -166,12 +325,20 @@ typedef struct generation_t
 	Genome** genomes;
 	/* number of genomes */
 	size_t genome_count;
+	/* number of allocated items in genomes */
+	size_t capacity;
 	} Generation,*GenerationPtr;
 
-SpreadSheetPtr SpreadSheetRead(FILE* in);
+SpreadSheetPtr SpreadSheetRead(FILE* in,size_t num_threads);
+SpreadSheetPtr SpreadSheetShared(const char* name,FILE* in,size_t num_threads);
+SpreadSheetPtr SpreadSheetMapCache(const char* filename);
+void SpreadSheetConvertCache(FILE* in,const char* filename,size_t num_threads);
 size_t SpreadSheetColumns(const SpreadSheetPtr ptr);
 size_t SpreadSheetRows(const SpreadSheetPtr ptr);
 floating_t SpreadSheetAt(const SpreadSheetPtr ptr,size_t y,size_t x);
+const floating_t* SpreadSheetColumn(const SpreadSheetPtr ptr,size_t x);
+SpreadSheetPtr SpreadSheetSample(const SpreadSheetPtr src,size_t n);
+void SpreadSheetFree(SpreadSheetPtr ptr);
 
 
 void GenomeFree(GenomePtr ptr);
@@ -185,6 +352,8 @@ void GenomePrint(const GenomePtr g,FILE* out);
 void GenomeMute(GenomePtr cfg);
 boolean_t GenomeEquals(const GenomePtr g1,const GenomePtr g2);
 void GenomeSave(const GenomePtr ptr);
+ProgramPtr GenomeCompile(GenomePtr g);
+void GenomeUncompile(GenomePtr g);
 
 OperatorListPtr OperatorsListNew();
 OperatorPtr OperatorListAt(OperatorListPtr list,size_t index);
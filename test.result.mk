@@ -0,0 +1,7 @@
+.PHONY=all
+OUTPUT=test.result
+all:${OUTPUT}.png ${OUTPUT}.plot1.jpeg
+${OUTPUT}.png: ${OUTPUT}.dot
+	dot -Tpng -o$@ $<
+${OUTPUT}.plot1.jpeg: ${OUTPUT}.R ${OUTPUT}.tsv
+	R --no-save < $<